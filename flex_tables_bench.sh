@@ -0,0 +1,141 @@
+#!/bin/sh
+# Builds every flex scanner of the repo in several table modes and
+# benchmarks them on common corpora.
+#
+#   ./flex_tables_bench.sh [SIZE_MB] [RUNS]
+#
+# For each scanner and mode it reports the throughput on a C-source corpus
+# and on an arithmetic-expression corpus (best of RUNS), the size of the
+# executable (text + data) and the bytes taken by the DFA tables
+# (yy_accept, yy_ec, yy_nxt, ... as listed by nm -S). Scanner output goes
+# to /dev/null, so the actions' printf cost is part of every number.
+#
+# Modes: -Cem is flex's default compressed tables with equivalence and
+# meta-equivalence classes; -Cf full tables; -CF fast tables; -Cr the
+# default tables with read(2) input instead of stdio.
+#
+# Needs flex, cc, nm and size. Work files go to flex_tables_bench/.
+# SCANNERS and MODES can be overridden from the environment.
+
+set -e
+
+SIZE_MB=${1:-32}
+RUNS=${2:-3}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+MODES=${MODES:-"-Cem -Cf -CF -Cr"}
+SCANNERS=${SCANNERS:-"practical01 practical06 practical07 practical08 operator_precedence"}
+TABLES='yy_accept|yy_acclist|yy_ec|yy_meta|yy_base|yy_def|yy_nxt|yy_chk|yy_transition|yy_start_state_list|yy_NUL_trans|yy_rule_can_match_eol'
+
+cd "$(dirname "$0")"
+WORK=flex_tables_bench
+mkdir -p "$WORK"
+
+for tool in flex "$CC" nm size; do
+    if ! command -v "$tool" >/dev/null 2>&1; then
+        echo "Error: $tool not found" >&2
+        exit 1
+    fi
+done
+
+# Driver for scanners whose own main does not take a file. practical06
+# and practical07 run through their own main, which reads the input into
+# memory and builds the line index their actions need.
+cat > "$WORK/driver.c" <<'EOF'
+#include <stdio.h>
+extern FILE *yyin;
+int yylex(void);
+int main(int argc, char *argv[]) {
+    if (argc < 2 || !(yyin = fopen(argv[1], "r"))) return 1;
+    while (yylex() != 0) {
+    }
+    return 0;
+}
+EOF
+
+# Corpora of about SIZE_MB each: the repo's C sources repeated, and
+# random "id + id * (id + id)" lines.
+bytes=$((SIZE_MB * 1024 * 1024))
+: > "$WORK/c_source.txt"
+while [ "$(wc -c < "$WORK/c_source.txt")" -lt "$bytes" ]; do
+    cat ./*.c >> "$WORK/c_source.txt"
+done
+awk -v bytes="$bytes" 'BEGIN {
+    srand(12); n = 0
+    while (n < bytes) {
+        line = "a"
+        terms = 2 + int(rand() * 10)
+        for (i = 0; i < terms; i++) {
+            op = rand() < 0.5 ? " + " : " * "
+            if (rand() < 0.2) line = line op "(x" i " + y" i ")"
+            else line = line op "v" int(rand() * 1000)
+        }
+        print line
+        n += length(line) + 1
+    }
+}' > "$WORK/expressions.txt"
+
+now_ns() {
+    date +%s%N
+}
+
+# Best wall time in ns of RUNS runs of "$@".
+best_ns() {
+    best=0
+    i=0
+    while [ "$i" -lt "$RUNS" ]; do
+        start=$(now_ns)
+        "$@" > /dev/null
+        end=$(now_ns)
+        t=$((end - start))
+        if [ "$best" -eq 0 ] || [ "$t" -lt "$best" ]; then best=$t; fi
+        i=$((i + 1))
+    done
+    echo "$best"
+}
+
+mb_per_s() {
+    awk -v bytes="$(wc -c < "$1")" -v ns="$2" 'BEGIN { printf "%.1f", bytes / 1048576 / (ns / 1e9) }'
+}
+
+run_scanner() {
+    # $1 scanner, $2 binary, $3 corpus
+    case "$1" in
+        practical01) "$2" -q < "$3" ;;
+        *) "$2" "$3" ;;
+    esac
+}
+
+printf '%-20s %-5s %12s %12s %12s %12s\n' scanner mode "C MB/s" "expr MB/s" "binary B" "tables B"
+for scanner in $SCANNERS; do
+    for mode in $MODES; do
+        name="$WORK/${scanner}${mode}"
+        flex "$mode" -o "$name.c" "$scanner.l"
+        case "$scanner" in
+            practical01|practical06|practical07)
+                "$CC" $CFLAGS -I. -c -o "$name.o" "$name.c"
+                "$CC" -o "$name" "$name.o" -lpthread
+                ;;
+            *)
+                "$CC" $CFLAGS -I. -Dmain=scanner_main -c -o "$name.o" "$name.c"
+                "$CC" $CFLAGS -o "$name" "$name.o" "$WORK/driver.c"
+                ;;
+        esac
+
+        tables=$(nm -S "$name.o" | awk -v re="^($TABLES)\$" '
+            function hex(s,    i, n) {
+                n = 0
+                for (i = 1; i <= length(s); i++) n = n * 16 + index("0123456789abcdef", tolower(substr(s, i, 1))) - 1
+                return n
+            }
+            $4 ~ re { sum += hex($2) }
+            END { print sum + 0 }')
+        binary=$(size "$name" | awk 'NR == 2 { print $1 + $2 }')
+        c_ns=$(best_ns run_scanner "$scanner" "$name" "$WORK/c_source.txt")
+        e_ns=$(best_ns run_scanner "$scanner" "$name" "$WORK/expressions.txt")
+
+        printf '%-20s %-5s %12s %12s %12s %12s\n' "$scanner" "$mode" \
+            "$(mb_per_s "$WORK/c_source.txt" "$c_ns")" \
+            "$(mb_per_s "$WORK/expressions.txt" "$e_ns")" "$binary" "$tables"
+    done
+done
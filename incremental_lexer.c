@@ -0,0 +1,693 @@
+/*
+ * Incremental re-lexing of an edited buffer with practical07.l's token
+ * rules, for editor use on large files.
+ *
+ *   gcc -O2 -o incremental_lexer incremental_lexer.c
+ *   ./incremental_lexer [-l LINES] [-e EDITS] [-c CHECK_EVERY] [-s SEED] [-t STREAM] [FILE]
+ *
+ * The lexer keeps every token of the buffer, whitespace included, so the
+ * tokens tile the text. For each token it stores its length, its kind,
+ * the start state the lexer was in when it began (flex's start
+ * condition; practical07.l has only INITIAL, but the state takes part in
+ * resynchronization so rule sets with states work the same way) and how
+ * many bytes past its end the scanner looked before deciding on it.
+ *
+ * After an edit, lexing restarts at the first token whose examined bytes
+ * reach the edit, in that token's start state, and stops as soon as a new
+ * token begins where an old token after the edit began, in the same
+ * state: from there on the old tokens are still right and are kept.
+ *
+ * Tokens live in chunks of a few hundred. Token offsets are not stored but
+ * summed from lengths, so an edit only rewrites the chunks it touches and
+ * never shifts the offsets of the tokens after it.
+ *
+ * Run as a program, it lexes FILE (or a generated file of LINES lines),
+ * applies EDITS random keystroke-sized edits, times each one and compares
+ * the token array with a full re-lex every CHECK_EVERY edits.
+ *
+ * The rules below are a hand translation of practical07.l. With -t, the
+ * first lex of FILE is compared token by token with STREAM, written by
+ * "practical07 -t STREAM FILE", so the two cannot drift apart unnoticed;
+ * incremental_lexer_check.sh runs that comparison on the repo's sources.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "token_stream.h"
+
+#define CHUNK_TARGET 256     /* tokens per chunk when chunks are rebuilt */
+#define CHUNK_MAX 512
+#define MAX_LOOKAHEAD 2      /* most bytes any rule looks past its token */
+
+/* practical07.l's token kinds, plus the whitespace the rules skip. */
+enum token_kind {
+    TK_IF, TK_ELSE, TK_WHILE, TK_FOR, TK_INT, TK_FLOAT,
+    TK_IDENTIFIER, TK_INTEGER, TK_FLOAT_NUM,
+    TK_PLUS, TK_MINUS, TK_MULTIPLY, TK_DIVIDE, TK_ASSIGN,
+    TK_GTE, TK_LTE, TK_EQ, TK_NEQ, TK_GT, TK_LT,
+    TK_LPAREN, TK_RPAREN, TK_LBRACKET, TK_RBRACKET, TK_LBRACE, TK_RBRACE,
+    TK_SEMICOLON, TK_COMMA, TK_UNKNOWN, TK_WHITESPACE, TK_KIND_COUNT
+};
+
+/* Names as practical07.l writes them to a token stream. */
+static const char *kind_names[TK_KIND_COUNT] = {
+    "IF", "ELSE", "WHILE", "FOR", "INT", "FLOAT",
+    "IDENTIFIER", "INTEGER", "FLOAT_NUM",
+    "PLUS", "MINUS", "MULTIPLY", "DIVIDE", "ASSIGN",
+    "GTE", "LTE", "EQ", "NEQ", "GT", "LT",
+    "LPAREN", "RPAREN", "LBRACKET", "RBRACKET", "LBRACE", "RBRACE",
+    "SEMICOLON", "COMMA", "UNKNOWN", "WHITESPACE"
+};
+
+/* One scanned token. */
+typedef struct {
+    uint32_t length;
+    uint8_t kind;
+    uint8_t lookahead;   /* bytes examined past the end; the end of input counts as one */
+    uint8_t state;       /* start state the token was scanned in */
+} Token;
+
+typedef struct {
+    uint32_t count;
+    uint32_t bytes;      /* sum of the token lengths */
+    Token tokens[CHUNK_MAX];
+} TokenChunk;
+
+typedef struct {
+    char *text;
+    size_t length, capacity;
+    TokenChunk **chunks;
+    size_t chunk_count, chunk_capacity;
+    size_t token_count;
+} IncrementalLexer;
+
+/* What one edit cost. */
+typedef struct {
+    size_t restart;          /* offset lexing resumed at */
+    size_t relexed_tokens;   /* tokens scanned */
+    size_t replaced_tokens;  /* old tokens dropped */
+    bool resynchronized;     /* stopped before the end of the buffer */
+} EditStats;
+
+/* A growable run of tokens. */
+typedef struct {
+    Token *tokens;
+    size_t count, capacity;
+} TokenRun;
+
+static bool run_push(TokenRun *run, Token token) {
+    if (run->count == run->capacity) {
+        size_t capacity = run->capacity ? run->capacity * 2 : 256;
+        Token *tokens = realloc(run->tokens, capacity * sizeof(Token));
+        if (!tokens) return false;
+        run->tokens = tokens;
+        run->capacity = capacity;
+    }
+    run->tokens[run->count++] = token;
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* practical07.l's rules                                             */
+/* ---------------------------------------------------------------- */
+
+static bool is_letter(int c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool is_digit(int c) {
+    return c >= '0' && c <= '9';
+}
+
+/* The keyword hash of practical07.l: one slot per keyword. */
+#define KEYWORD_SLOTS 8
+
+static const struct {
+    const char *text;
+    uint32_t length;
+    enum token_kind kind;
+} keyword_slots[KEYWORD_SLOTS] = {
+    { "while", 5, TK_WHILE }, { "int", 3, TK_INT }, { "else", 4, TK_ELSE }, { NULL, 0, TK_IDENTIFIER },
+    { "for", 3, TK_FOR }, { NULL, 0, TK_IDENTIFIER }, { "float", 5, TK_FLOAT }, { "if", 2, TK_IF }
+};
+
+static enum token_kind keyword_kind(const char *text, uint32_t length) {
+    unsigned slot = ((unsigned char)text[0] + (unsigned char)text[length - 1] + (length << 2)) & (KEYWORD_SLOTS - 1);
+    if (keyword_slots[slot].length == length && memcmp(keyword_slots[slot].text, text, length) == 0) {
+        return keyword_slots[slot].kind;
+    }
+    return TK_IDENTIFIER;
+}
+
+/*
+ * Scans the token at text[pos] (pos < len), with flex's longest-match
+ * rule, and records how far past its end the scanner had to look. *state
+ * is the start state, updated for the next token; these rules never
+ * change it.
+ */
+static Token scan_token(const char *text, size_t len, size_t pos, uint8_t *state) {
+    Token t = { 1, TK_UNKNOWN, 0, *state };
+    unsigned char c = (unsigned char)text[pos];
+    unsigned char next = pos + 1 < len ? (unsigned char)text[pos + 1] : 0;
+    size_t end = pos + 1;
+
+    if (is_letter(c)) {
+        while (end < len && (is_letter(text[end]) || is_digit(text[end]) || text[end] == '_')) end++;
+        t.length = (uint32_t)(end - pos);
+        t.kind = (uint8_t)keyword_kind(text + pos, t.length);
+        t.lookahead = 1;
+    } else if (is_digit(c)) {
+        while (end < len && is_digit(text[end])) end++;
+        t.kind = TK_INTEGER;
+        t.lookahead = 1;
+        if (end < len && text[end] == '.') {
+            if (end + 1 < len && is_digit(text[end + 1])) {
+                end += 2;
+                while (end < len && is_digit(text[end])) end++;
+                t.kind = TK_FLOAT_NUM;
+            } else {
+                t.lookahead = 2;   /* saw "." and what follows it */
+            }
+        }
+        t.length = (uint32_t)(end - pos);
+    } else if (c == ' ' || c == '\t' || c == '\n') {
+        while (end < len && (text[end] == ' ' || text[end] == '\t' || text[end] == '\n')) end++;
+        t.length = (uint32_t)(end - pos);
+        t.kind = TK_WHITESPACE;
+        t.lookahead = 1;
+    } else if (c == '>' || c == '<' || c == '=' || c == '!') {
+        if (next == '=' && pos + 1 < len) {
+            t.length = 2;
+            t.kind = c == '>' ? TK_GTE : c == '<' ? TK_LTE : c == '=' ? TK_EQ : TK_NEQ;
+        } else {
+            t.kind = c == '>' ? TK_GT : c == '<' ? TK_LT : c == '=' ? TK_ASSIGN : TK_UNKNOWN;
+            t.lookahead = 1;
+        }
+    } else {
+        switch (c) {
+        case '+': t.kind = TK_PLUS; break;
+        case '-': t.kind = TK_MINUS; break;
+        case '*': t.kind = TK_MULTIPLY; break;
+        case '/': t.kind = TK_DIVIDE; break;
+        case '(': t.kind = TK_LPAREN; break;
+        case ')': t.kind = TK_RPAREN; break;
+        case '[': t.kind = TK_LBRACKET; break;
+        case ']': t.kind = TK_RBRACKET; break;
+        case '{': t.kind = TK_LBRACE; break;
+        case '}': t.kind = TK_RBRACE; break;
+        case ';': t.kind = TK_SEMICOLON; break;
+        case ',': t.kind = TK_COMMA; break;
+        default: break;
+        }
+    }
+    return t;
+}
+
+/* Every token of text[from..len) in start state state. */
+static bool scan_range(const char *text, size_t len, size_t from, uint8_t state, TokenRun *run) {
+    while (from < len) {
+        Token t = scan_token(text, len, from, &state);
+        if (!run_push(run, t)) return false;
+        from += t.length;
+    }
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* Token chunks                                                      */
+/* ---------------------------------------------------------------- */
+
+/* Position of a token: chunk, index in it, and its offset in the text. */
+typedef struct {
+    size_t chunk;
+    size_t index;
+    size_t offset;
+} TokenCursor;
+
+static bool at_end(const IncrementalLexer *lx, const TokenCursor *cur) {
+    return cur->chunk >= lx->chunk_count;
+}
+
+static const Token *cursor_token(const IncrementalLexer *lx, const TokenCursor *cur) {
+    return &lx->chunks[cur->chunk]->tokens[cur->index];
+}
+
+static void cursor_next(const IncrementalLexer *lx, TokenCursor *cur) {
+    cur->offset += cursor_token(lx, cur)->length;
+    if (++cur->index == lx->chunks[cur->chunk]->count) {
+        cur->chunk++;
+        cur->index = 0;
+    }
+}
+
+/* Steps back one token; returns false at the first token. */
+static bool cursor_prev(const IncrementalLexer *lx, TokenCursor *cur) {
+    if (cur->index == 0) {
+        if (cur->chunk == 0) return false;
+        cur->chunk--;
+        cur->index = lx->chunks[cur->chunk]->count;
+    }
+    cur->index--;
+    cur->offset -= cursor_token(lx, cur)->length;
+    return true;
+}
+
+/* The token containing offset, or the last token if offset is the end. */
+static TokenCursor find_token(const IncrementalLexer *lx, size_t offset) {
+    TokenCursor cur = { 0, 0, 0 };
+    while (cur.chunk + 1 < lx->chunk_count && cur.offset + lx->chunks[cur.chunk]->bytes <= offset) {
+        cur.offset += lx->chunks[cur.chunk]->bytes;
+        cur.chunk++;
+    }
+    const TokenChunk *chunk = lx->chunks[cur.chunk];
+    while (cur.index + 1 < chunk->count && cur.offset + chunk->tokens[cur.index].length <= offset) {
+        cur.offset += chunk->tokens[cur.index].length;
+        cur.index++;
+    }
+    return cur;
+}
+
+/*
+ * Replaces the chunks first..last (inclusive; last may be chunk_count
+ * for none) with chunks holding tokens, CHUNK_TARGET to a chunk.
+ */
+static bool replace_chunks(IncrementalLexer *lx, size_t first, size_t last, const TokenRun *tokens) {
+    size_t old = (last < lx->chunk_count ? last + 1 : lx->chunk_count) - first;
+    size_t fresh = (tokens->count + CHUNK_TARGET - 1) / CHUNK_TARGET;
+    size_t count = lx->chunk_count - old + fresh;
+
+    if (count > lx->chunk_capacity) {
+        size_t capacity = lx->chunk_capacity ? lx->chunk_capacity : 64;
+        while (capacity < count) capacity *= 2;
+        TokenChunk **chunks = realloc(lx->chunks, capacity * sizeof(TokenChunk *));
+        if (!chunks) return false;
+        lx->chunks = chunks;
+        lx->chunk_capacity = capacity;
+    }
+
+    TokenChunk **made = malloc((fresh ? fresh : 1) * sizeof(TokenChunk *));
+    if (!made) return false;
+    for (size_t c = 0; c < fresh; c++) {
+        made[c] = malloc(sizeof(TokenChunk));
+        if (!made[c]) {
+            while (c > 0) free(made[--c]);
+            free(made);
+            return false;
+        }
+        size_t from = c * CHUNK_TARGET;
+        size_t n = tokens->count - from < CHUNK_TARGET ? tokens->count - from : CHUNK_TARGET;
+        made[c]->count = (uint32_t)n;
+        made[c]->bytes = 0;
+        memcpy(made[c]->tokens, tokens->tokens + from, n * sizeof(Token));
+        for (size_t i = 0; i < n; i++) made[c]->bytes += made[c]->tokens[i].length;
+    }
+
+    for (size_t c = first; c < first + old; c++) free(lx->chunks[c]);
+    memmove(lx->chunks + first + fresh, lx->chunks + first + old, (lx->chunk_count - first - old) * sizeof(TokenChunk *));
+    memcpy(lx->chunks + first, made, fresh * sizeof(TokenChunk *));
+    lx->chunk_count = count;
+    free(made);
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* Incremental lexer                                                 */
+/* ---------------------------------------------------------------- */
+
+static void lexer_free(IncrementalLexer *lx) {
+    for (size_t c = 0; c < lx->chunk_count; c++) free(lx->chunks[c]);
+    free(lx->chunks);
+    free(lx->text);
+    memset(lx, 0, sizeof(*lx));
+}
+
+/* Copies text and lexes all of it. */
+static bool lexer_init(IncrementalLexer *lx, const char *text, size_t len) {
+    TokenRun run = { 0 };
+    memset(lx, 0, sizeof(*lx));
+    lx->capacity = len + 4096;
+    lx->text = malloc(lx->capacity);
+    if (!lx->text) return false;
+    memcpy(lx->text, text, len);
+    lx->length = len;
+
+    bool ok = scan_range(lx->text, len, 0, 0, &run) && replace_chunks(lx, 0, 0, &run);
+    if (ok) lx->token_count = run.count;
+    free(run.tokens);
+    if (!ok) lexer_free(lx);
+    return ok;
+}
+
+/*
+ * Replaces removed bytes at offset with inserted[0..inserted_len) and
+ * brings the tokens up to date. Returns false if out of memory, leaving
+ * the lexer unusable, or if the range is outside the text.
+ */
+static bool lexer_edit(IncrementalLexer *lx, size_t offset, size_t removed,
+                       const char *inserted, size_t inserted_len, EditStats *stats) {
+    if (offset > lx->length || removed > lx->length - offset) return false;
+    memset(stats, 0, sizeof(*stats));
+
+    /* first token whose examined bytes reach the edit; only tokens ending
+       within MAX_LOOKAHEAD bytes of it can */
+    TokenCursor first = { 0, 0, 0 };
+    uint8_t state = 0;
+    if (lx->chunk_count > 0) {
+        first = find_token(lx, offset);
+        TokenCursor prev = first;
+        while (cursor_prev(lx, &prev) && prev.offset + cursor_token(lx, &prev)->length + MAX_LOOKAHEAD > offset) {
+            if (prev.offset + cursor_token(lx, &prev)->length + cursor_token(lx, &prev)->lookahead > offset) first = prev;
+        }
+        state = cursor_token(lx, &first)->state;
+    }
+    stats->restart = first.offset;
+
+    /* edit the text */
+    size_t new_length = lx->length - removed + inserted_len;
+    if (new_length > lx->capacity) {
+        size_t capacity = lx->capacity * 2 > new_length ? lx->capacity * 2 : new_length + 4096;
+        char *text = realloc(lx->text, capacity);
+        if (!text) return false;
+        lx->text = text;
+        lx->capacity = capacity;
+    }
+    memmove(lx->text + offset + inserted_len, lx->text + offset + removed, lx->length - offset - removed);
+    memcpy(lx->text + offset, inserted, inserted_len);
+
+    /*
+     * Re-lex until a token boundary past the edit meets an old token
+     * boundary in the same state. old walks the old tokens in old
+     * offsets; the new token list is the kept head of the first chunk,
+     * the new tokens, and the kept tail of old's chunk.
+     */
+    TokenRun run = { 0 };
+    TokenCursor old = first;
+    size_t pos = first.offset;
+    size_t edit_end_new = offset + inserted_len, edit_end_old = offset + removed;
+    bool ok = true;
+
+    if (lx->chunk_count > 0) {
+        for (size_t i = 0; i < first.index && ok; i++) ok = run_push(&run, lx->chunks[first.chunk]->tokens[i]);
+    }
+    while (ok && pos < new_length) {
+        if (pos >= edit_end_new) {
+            size_t old_pos = pos - inserted_len + removed;
+            while (!at_end(lx, &old) && old.offset < old_pos) cursor_next(lx, &old);
+            if (!at_end(lx, &old) && old.offset == old_pos && old_pos >= edit_end_old &&
+                cursor_token(lx, &old)->state == state) {
+                stats->resynchronized = true;
+                break;
+            }
+        }
+        Token t = scan_token(lx->text, new_length, pos, &state);
+        ok = run_push(&run, t);
+        pos += t.length;
+        stats->relexed_tokens++;
+    }
+    if (ok && !stats->resynchronized) {
+        while (!at_end(lx, &old)) cursor_next(lx, &old);
+    }
+
+    size_t last_chunk = old.chunk;
+    if (ok && !at_end(lx, &old)) {
+        const TokenChunk *tail = lx->chunks[old.chunk];
+        for (size_t i = old.index; i < tail->count && ok; i++) ok = run_push(&run, tail->tokens[i]);
+    }
+
+    /* old tokens replaced: from first up to old */
+    if (ok) {
+        size_t dropped = 0;
+        for (TokenCursor c = first; !at_end(lx, &c) && (c.chunk < old.chunk || (c.chunk == old.chunk && c.index < old.index));
+             cursor_next(lx, &c)) {
+            dropped++;
+        }
+        stats->replaced_tokens = dropped;
+        ok = replace_chunks(lx, first.chunk, last_chunk, &run);
+        lx->token_count = lx->token_count - dropped + stats->relexed_tokens;
+    }
+    free(run.tokens);
+    lx->length = new_length;
+    return ok;
+}
+
+/* ---------------------------------------------------------------- */
+/* Benchmark and check                                               */
+/* ---------------------------------------------------------------- */
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 11);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* A file of practical07-style statements, one per line. */
+static char *generate_source(size_t lines, size_t *len) {
+    static const char *templates[] = {
+        "int v%u = %u;\n",
+        "float f%u = %u.5 * (a%u + b);\n",
+        "if (x%u >= %u) {\n",
+        "} else {\n",
+        "while (i%u < n) { s = s + arr[i%u]; }\n",
+        "for (i = 0; i <= %u; i = i + 1) {\n",
+        "    total%u = total%u - %u / 2;\n",
+        "}\n",
+        "    flag = count%u != %u;\n",
+    };
+    size_t capacity = lines * 48 + 64, used = 0;
+    char *text = malloc(capacity);
+    if (!text) return NULL;
+    for (size_t i = 0; i < lines; i++) {
+        const char *t = templates[next_random() % (sizeof(templates) / sizeof(templates[0]))];
+        unsigned a = next_random() % 1000, b = next_random() % 100;
+        if (capacity - used < 128) {
+            char *grown = realloc(text, capacity * 2);
+            if (!grown) {
+                free(text);
+                return NULL;
+            }
+            text = grown;
+            capacity *= 2;
+        }
+        used += (size_t)snprintf(text + used, capacity - used, t, a, b, a);
+    }
+    *len = used;
+    return text;
+}
+
+static char *read_file(const char *path, size_t *len) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        fprintf(stderr, "Error: Cannot open file %s\n", path);
+        return NULL;
+    }
+    fseek(in, 0, SEEK_END);
+    *len = (size_t)ftell(in);
+    fseek(in, 0, SEEK_SET);
+    char *text = malloc(*len ? *len : 1);
+    if (text && fread(text, 1, *len, in) != *len) {
+        free(text);
+        text = NULL;
+    }
+    fclose(in);
+    if (!text) fprintf(stderr, "Error: Cannot read file %s\n", path);
+    return text;
+}
+
+/* Compares the tokens with a full re-lex of the text. */
+static bool check_tokens(const IncrementalLexer *lx) {
+    TokenRun full = { 0 };
+    if (!scan_range(lx->text, lx->length, 0, 0, &full)) return false;
+    bool same = full.count == lx->token_count;
+    size_t i = 0;
+    for (size_t c = 0; c < lx->chunk_count && same; c++) {
+        const TokenChunk *chunk = lx->chunks[c];
+        uint32_t bytes = 0;
+        for (size_t k = 0; k < chunk->count && same; k++, i++) {
+            const Token *a = &chunk->tokens[k], *b = &full.tokens[i];
+            same = i < full.count && a->length == b->length && a->kind == b->kind &&
+                   a->lookahead == b->lookahead && a->state == b->state;
+            bytes += a->length;
+        }
+        same = same && bytes == chunk->bytes && chunk->count > 0;
+    }
+    free(full.tokens);
+    return same && i == lx->token_count;
+}
+
+/*
+ * Compares the tokens with the stream practical07 wrote for the same
+ * text: every token but whitespace, in order, with the same kind name,
+ * offset, length and line. Reports the first difference.
+ */
+static bool compare_with_stream(const IncrementalLexer *lx, const char *target) {
+    struct token_stream_view v;
+    if (token_stream_open(target, &v) != 0) return false;
+
+    size_t offset = 0, line = 1;
+    uint64_t j = 0;
+    bool same = true;
+    for (size_t c = 0; c < lx->chunk_count && same; c++) {
+        const TokenChunk *chunk = lx->chunks[c];
+        for (uint32_t k = 0; k < chunk->count && same; k++) {
+            const Token *t = &chunk->tokens[k];
+            if (t->kind == TK_WHITESPACE) {
+                for (uint32_t b = 0; b < t->length; b++) line += lx->text[offset + b] == '\n';
+            } else if (j == v.count) {
+                fprintf(stderr, "Error: Stream ends before the %s at offset %zu\n", kind_names[t->kind], offset);
+                same = false;
+            } else {
+                const char *name = token_stream_kind_name(&v, v.kinds[j]);
+                if (!name || strcmp(name, kind_names[t->kind]) != 0 || v.starts[j] != offset ||
+                    v.lengths[j] != t->length || v.lines[j] != line) {
+                    fprintf(stderr, "Error: Token %llu differs: %s at %zu+%u line %zu, stream has %s at %u+%u line %u\n",
+                            (unsigned long long)j, kind_names[t->kind], offset, t->length, line,
+                            name ? name : "?", v.starts[j], v.lengths[j], v.lines[j]);
+                    same = false;
+                }
+                j++;
+            }
+            offset += t->length;
+        }
+    }
+    if (same && j != v.count) {
+        fprintf(stderr, "Error: Stream has %llu tokens after the end of the text\n", (unsigned long long)(v.count - j));
+        same = false;
+    }
+    if (same) printf("Same tokens as %s: %llu\n", target, (unsigned long long)v.count);
+    token_stream_close(&v);
+    return same;
+}
+
+/* A random keystroke-sized edit: type or delete a character, a word, a line. */
+static size_t random_edit(const IncrementalLexer *lx, size_t *offset, size_t *removed, char *buf) {
+    static const char typed[] = "abz019 .=;<>!(\n_";
+    static const char *pasted[] = { "count", "42", "3.14", " = ", "if (a < b) ", "\n", "x = y + 1;\n", "!=" };
+    size_t len = 0;
+
+    *offset = lx->length ? next_random() % (lx->length + 1) : 0;
+    *removed = 0;
+    switch (next_random() % 4) {
+    case 0:
+        buf[len++] = typed[next_random() % (sizeof(typed) - 1)];
+        break;
+    case 1:
+        *removed = *offset < lx->length ? 1 : 0;
+        break;
+    case 2: {
+        const char *p = pasted[next_random() % (sizeof(pasted) / sizeof(pasted[0]))];
+        len = strlen(p);
+        memcpy(buf, p, len);
+        break;
+    }
+    default:
+        *removed = next_random() % 24;
+        if (*removed > lx->length - *offset) *removed = lx->length - *offset;
+        break;
+    }
+    return len;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    size_t lines = 100000, edits = 10000, check_every = 1000;
+    const char *path = NULL, *stream = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            lines = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            edits = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            check_every = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            rng_state = strtoull(argv[++i], NULL, 10) | 1;
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            stream = argv[++i];
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [-l LINES] [-e EDITS] [-c CHECK_EVERY] [-s SEED] [-t STREAM] [FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (stream && !path) {
+        fprintf(stderr, "Error: -t needs the FILE the stream was written from\n");
+        return 1;
+    }
+
+    size_t len;
+    char *source = path ? read_file(path, &len) : generate_source(lines, &len);
+    if (!source) return 1;
+
+    IncrementalLexer lx;
+    double start = now();
+    if (!lexer_init(&lx, source, len)) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return 1;
+    }
+    double full_time = now() - start;
+    free(source);
+    printf("Input: %zu bytes, %zu tokens (whitespace included)\n", lx.length, lx.token_count);
+    printf("Full lex: %.3f ms\n", full_time * 1e3);
+    if (stream && !compare_with_stream(&lx, stream)) return 1;
+
+    double *times = malloc((edits ? edits : 1) * sizeof(double));
+    size_t relexed = 0, resynced = 0, checks = 0;
+    char buf[64];
+    if (!times) return 1;
+
+    for (size_t e = 0; e < edits; e++) {
+        size_t offset, removed;
+        size_t inserted = random_edit(&lx, &offset, &removed, buf);
+        EditStats stats;
+
+        start = now();
+        bool ok = lexer_edit(&lx, offset, removed, buf, inserted, &stats);
+        times[e] = now() - start;
+        if (!ok) {
+            fprintf(stderr, "Error: Edit %zu failed\n", e);
+            return 1;
+        }
+        relexed += stats.relexed_tokens;
+        resynced += stats.resynchronized;
+
+        if (check_every && ((e + 1) % check_every == 0 || e + 1 == edits)) {
+            checks++;
+            if (!check_tokens(&lx)) {
+                fprintf(stderr, "Error: Tokens differ from a full re-lex after edit %zu\n", e);
+                return 1;
+            }
+        }
+    }
+
+    if (edits > 0) {
+        double total = 0;
+        for (size_t e = 0; e < edits; e++) total += times[e];
+        qsort(times, edits, sizeof(double), compare_doubles);
+        printf("Edits: %zu, %zu resynchronized before the end of the buffer\n", edits, resynced);
+        printf("Tokens re-lexed per edit: %.2f\n", (double)relexed / (double)edits);
+        printf("Edit time: mean %.1f us, median %.1f us, p99 %.1f us, max %.1f us\n",
+               total / (double)edits * 1e6, times[edits / 2] * 1e6, times[edits * 99 / 100] * 1e6,
+               times[edits - 1] * 1e6);
+        printf("Checked against a full re-lex: %zu times, all equal\n", checks);
+    }
+    free(times);
+    lexer_free(&lx);
+    return 0;
+}
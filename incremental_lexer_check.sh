@@ -0,0 +1,52 @@
+#!/bin/sh
+# Checks that incremental_lexer.c's hand-written rules still agree with
+# practical07.l.
+#
+#   ./incremental_lexer_check.sh [SIZE_MB]
+#
+# practical07 is built from practical07.l with flex, or with scangen when
+# flex is not installed, and writes a token stream (-t) for each corpus:
+# the repo's C sources repeated to SIZE_MB, and random bytes. The
+# incremental lexer lexes the same file and compares every token's kind,
+# offset, length and line with the stream, then runs a short edit session.
+#
+# Needs cc. Work files go to incremental_lexer_check/.
+
+set -e
+
+SIZE_MB=${1:-4}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+
+cd "$(dirname "$0")"
+WORK=incremental_lexer_check
+mkdir -p "$WORK"
+
+if command -v flex >/dev/null 2>&1; then
+    flex -o "$WORK/practical07.c" practical07.l
+else
+    "$CC" $CFLAGS -o "$WORK/scangen" scangen.c
+    "$WORK/scangen" -o "$WORK/practical07.c" practical07.l
+fi
+"$CC" $CFLAGS -I. -o "$WORK/practical07" "$WORK/practical07.c"
+"$CC" $CFLAGS -o "$WORK/incremental_lexer" incremental_lexer.c
+
+bytes=$((SIZE_MB * 1024 * 1024))
+: > "$WORK/c_source.txt"
+while [ "$(wc -c < "$WORK/c_source.txt")" -lt "$bytes" ]; do
+    cat ./*.c >> "$WORK/c_source.txt"
+done
+head -c $((bytes / 8)) /dev/urandom > "$WORK/random.bin"
+
+status=0
+for corpus in c_source.txt random.bin; do
+    "$WORK/practical07" -t "$WORK/tokens.bin" "$WORK/$corpus" > /dev/null
+    if "$WORK/incremental_lexer" -e 1000 -c 100 -t "$WORK/tokens.bin" "$WORK/$corpus" > "$WORK/check.out"; then
+        echo "$corpus: $(grep '^Same tokens' "$WORK/check.out")"
+    else
+        echo "$corpus: tokens DIFFER from practical07" >&2
+        status=1
+    fi
+done
+rm -f "$WORK/tokens.bin" "$WORK/check.out"
+exit $status
@@ -369,7 +369,54 @@ char *yytext;
 #define INITIAL 0
 #line 2 "practical08.l"
 #include <stdio.h>
-#line 373 "lex.yy.c"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/*
+ * Streamed input is read with read(2) in page-multiple pieces of up to
+ * 1 MiB straight into the scanner's buffer, which align_buffer puts on a
+ * page boundary. The flex 2.5 skeleton defines YY_BUF_SIZE
+ * unconditionally, hence the #undef.
+ */
+#undef YY_BUF_SIZE
+#define YY_READ_BUF_SIZE (1 << 20)
+#define YY_BUF_SIZE (YY_READ_BUF_SIZE + 4096)
+#define SMALL_READ 8192          /* the skeleton's fread size, for the benchmark */
+
+static int small_reads = 0;      /* use the skeleton's 8 KiB fread instead */
+static int quiet = 0;            /* -q: count tokens instead of printing them */
+static long token_count = 0;
+
+#ifndef _WIN32
+#define YY_INPUT(buf, result, max_size) \
+    { \
+        size_t want_ = (size_t)(max_size); \
+        if (small_reads) { \
+            if (want_ > SMALL_READ) want_ = SMALL_READ; \
+            result = (int)fread((buf), 1, want_, yyin); \
+            if (result == 0 && ferror(yyin)) YY_FATAL_ERROR("input in flex scanner failed"); \
+        } else { \
+            if (want_ >= 4096) want_ &= ~(size_t)4095; \
+            long n_ = (long)read(fileno(yyin), (buf), want_); \
+            if (n_ < 0) YY_FATAL_ERROR("input in flex scanner failed"); \
+            result = (int)n_; \
+        } \
+    }
+#endif
+
+static void token(const char *kind) {
+    token_count++;
+    if (!quiet) printf("%s(%s)\n", kind, yytext);
+}
+#line 420 "lex.yy.c"
 
 /* Macros after this point can all be overridden by user definitions in
  * section 1.
@@ -520,9 +567,9 @@ YY_DECL
 	register char *yy_cp, *yy_bp;
 	register int yy_act;
 
-#line 9 "practical08.l"
+#line 56 "practical08.l"
 
-#line 526 "lex.yy.c"
+#line 573 "lex.yy.c"
 
 	if ( yy_init )
 		{
@@ -607,60 +654,60 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 10 "practical08.l"
-{ printf("IDENT(%s)\n", yytext); }
+#line 57 "practical08.l"
+{ token("IDENT"); }
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 11 "practical08.l"
-{ printf("NUMBER(%s)\n", yytext); }
+#line 58 "practical08.l"
+{ token("NUMBER"); }
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 12 "practical08.l"
-{ printf("OP(%s)\n", yytext); }
+#line 59 "practical08.l"
+{ token("OP"); }
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 13 "practical08.l"
-{ printf("LPAREN(%s)\n", yytext); }
+#line 60 "practical08.l"
+{ token("LPAREN"); }
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 14 "practical08.l"
-{ printf("RPAREN(%s)\n", yytext); }
+#line 61 "practical08.l"
+{ token("RPAREN"); }
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 15 "practical08.l"
-{ printf("LBRACK(%s)\n", yytext); }
+#line 62 "practical08.l"
+{ token("LBRACK"); }
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 16 "practical08.l"
-{ printf("RBRACK(%s)\n", yytext); }
+#line 63 "practical08.l"
+{ token("RBRACK"); }
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 17 "practical08.l"
-{ printf("SEMI(%s)\n", yytext); }
+#line 64 "practical08.l"
+{ token("SEMI"); }
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 18 "practical08.l"
+#line 65 "practical08.l"
 ;
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 19 "practical08.l"
-{ printf("UNKNOWN(%s)\n", yytext); }
+#line 66 "practical08.l"
+{ token("UNKNOWN"); }
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 20 "practical08.l"
+#line 67 "practical08.l"
 ECHO;
 	YY_BREAK
-#line 664 "lex.yy.c"
+#line 711 "lex.yy.c"
 case YY_STATE_EOF(INITIAL):
 	yyterminate();
 
@@ -1546,13 +1593,184 @@ int main()
 	return 0;
 	}
 #endif
-#line 20 "practical08.l"
+#line 67 "practical08.l"
 
 
 int yywrap() { return 1; }
 
-int main() {
-    printf("PRACTICAL 08 LEXER: Tokenizing input for optimization demo\n");
+#ifndef _WIN32
+/*
+ * Maps path so that two NUL bytes follow its contents, as yy_scan_buffer
+ * requires: an anonymous mapping one page past the file is reserved and
+ * the file is mapped over its start. The mapping is private and writable
+ * because the scanner writes yytext's terminator into the buffer; only
+ * the pages it writes to are copied, and nothing goes through read(2).
+ */
+static char *map_input(const char *path, size_t *len, size_t *mapped) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open file %s\n", path);
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    *len = (size_t)st.st_size;
+    *mapped = (*len + 2 + page - 1) / page * page;
+
+    char *base = mmap(NULL, *mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base != MAP_FAILED && *len > 0 &&
+        mmap(base, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, *mapped);
+        base = MAP_FAILED;
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map file %s\n", path);
+        return NULL;
+    }
+    madvise(base, *len, MADV_SEQUENTIAL);
+    return base;
+}
+
+/* Scans path in place with yy_scan_buffer. */
+static int scan_mapped(const char *path) {
+    size_t len, mapped;
+    char *base = map_input(path, &len, &mapped);
+    if (!base) return 1;
+
+    YY_BUFFER_STATE buffer = yy_scan_buffer(base, (yy_size_t)(len + 2));
     yylex();
+    yy_delete_buffer(buffer);
+    munmap(base, mapped);
     return 0;
-}
\ No newline at end of file
+}
+#endif
+
+#if !defined(_WIN32) && !defined(YY_SCANGEN)
+/*
+ * Moves the current buffer's storage to a page-aligned block of the same
+ * size, so each refill that starts at the front of the buffer reads into
+ * whole pages. A refill after a partial token starts past the carried
+ * over bytes, as flex keeps them at the front. posix_memalign's memory
+ * may be realloc'd and freed, so flex can still grow and delete the
+ * buffer; if it fails the buffer is left as it is. This reaches into
+ * flex's buffer struct, so a scanner built with scangen skips it.
+ */
+static void align_buffer(void) {
+    YY_BUFFER_STATE b = YY_CURRENT_BUFFER;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    void *aligned;
+
+    if (!b || (uintptr_t)b->yy_ch_buf % page == 0) return;
+    if (posix_memalign(&aligned, page, b->yy_buf_size + 2) != 0) return;
+    free(b->yy_ch_buf);
+    b->yy_ch_buf = aligned;
+    yy_flush_buffer(b);
+}
+#else
+static void align_buffer(void) {}
+#endif
+
+static int scan_file(const char *path) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        fprintf(stderr, "Error: Cannot open file %s\n", path);
+        return 1;
+    }
+    yyrestart(in);
+    align_buffer();
+    yylex();
+    fclose(in);
+    return 0;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Best of runs for the skeleton's fread, large read(2) and mmap input. */
+static int benchmark(const char *path, int runs) {
+    static const char *modes[] = { "fread 8 KiB", "read 1 MiB", "mmap" };
+    double best[3] = { 0, 0, 0 };
+    struct stat st;
+
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open file %s\n", path);
+        return 1;
+    }
+    quiet = 1;
+    for (int mode = 0; mode < 3; mode++) {
+        for (int r = 0; r < runs; r++) {
+            double start = now();
+            int status;
+            small_reads = mode == 0;
+#ifndef _WIN32
+            status = mode == 2 ? scan_mapped(path) : scan_file(path);
+#else
+            status = scan_file(path);
+#endif
+            if (status != 0) return status;
+            double t = now() - start;
+            if (r == 0 || t < best[mode]) best[mode] = t;
+        }
+    }
+
+    double mb = (double)st.st_size / (1 << 20);
+    printf("%-12s %10s %10s\n", "input", "MB/s", "speedup");
+    for (int mode = 0; mode < 3; mode++) {
+        printf("%-12s %10.1f %9.2fx\n", modes[mode], mb / best[mode], best[0] / best[mode]);
+    }
+    printf("Tokens per run: %ld\n", token_count / (3 * runs));
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    int use_mmap = 0, bench = 0, status = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-m") == 0) {
+            use_mmap = 1;
+        } else if (strcmp(argv[i], "-q") == 0) {
+            quiet = 1;
+        } else if (strcmp(argv[i], "-b") == 0) {
+            bench = 1;
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [-m] [-q] [-b] [FILE]\n", argv[0]);
+            fprintf(stderr, "  -m  map FILE and scan it in place\n");
+            fprintf(stderr, "  -q  count tokens instead of printing them\n");
+            fprintf(stderr, "  -b  benchmark FILE with fread, read(2) and mmap input\n");
+            return 1;
+        }
+    }
+    if (bench) {
+        if (!path) {
+            fprintf(stderr, "Error: -b needs a FILE\n");
+            return 1;
+        }
+        return benchmark(path, 3);
+    }
+
+    if (!quiet) printf("PRACTICAL 08 LEXER: Tokenizing input for optimization demo\n");
+    if (path && use_mmap) {
+#ifndef _WIN32
+        status = scan_mapped(path);
+#else
+        status = scan_file(path);
+#endif
+    } else if (path) {
+        status = scan_file(path);
+    } else {
+        yyrestart(stdin);
+        align_buffer();
+        yylex();
+    }
+    if (quiet && status == 0) printf("Tokens: %ld\n", token_count);
+    return status;
+}
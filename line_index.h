@@ -0,0 +1,126 @@
+/*
+ * Line-start index over an input held in memory, for lexers that report
+ * line and column numbers without matching newlines themselves.
+ *
+ * line_index_build makes one pass over the text with memchr, which the C
+ * library implements with SIMD compares, and records the offset where
+ * each line starts. Offsets are then turned into 1-based line and column
+ * numbers by binary search, in O(log lines), or from a cursor when they
+ * come in increasing order.
+ */
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct line_index {
+    size_t *starts;     /* starts[i] is the offset of line i + 1 */
+    size_t count;       /* number of lines, at least 1 */
+};
+
+/* Builds the index of text[0..len). Returns -1 if out of memory. */
+static inline int line_index_build(struct line_index *index, const char *text, size_t len) {
+    size_t capacity = 1024;
+    index->starts = malloc(capacity * sizeof(size_t));
+    if (!index->starts) return -1;
+    index->starts[0] = 0;
+    index->count = 1;
+
+    const char *p = text, *end = text + len;
+    while (p < end && (p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        p++;
+        if (index->count == capacity) {
+            size_t *starts = realloc(index->starts, capacity * 2 * sizeof(size_t));
+            if (!starts) {
+                free(index->starts);
+                index->starts = NULL;
+                return -1;
+            }
+            index->starts = starts;
+            capacity *= 2;
+        }
+        index->starts[index->count++] = (size_t)(p - text);
+    }
+    return 0;
+}
+
+static inline void line_index_free(struct line_index *index) {
+    free(index->starts);
+    index->starts = NULL;
+    index->count = 0;
+}
+
+/* Last i in [lo, hi) with starts[i] <= offset, given starts[lo] <= offset. */
+static inline size_t line_index_search(const struct line_index *index, size_t offset, size_t lo, size_t hi) {
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->starts[mid] <= offset) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Line of offset, from 1. */
+static inline size_t line_index_line(const struct line_index *index, size_t offset) {
+    return line_index_search(index, offset, 0, index->count) + 1;
+}
+
+/*
+ * Line of offset, from 1, searching outward from *cursor, the line index
+ * of the previous lookup. A lexer asks for offsets in increasing order,
+ * so the answer is usually the cursor's line or the next one; a jump of
+ * d lines costs O(log d).
+ */
+static inline size_t line_index_seek(const struct line_index *index, size_t offset, size_t *cursor) {
+    size_t lo = *cursor < index->count ? *cursor : 0;
+    if (index->starts[lo] > offset) lo = 0;
+    size_t step = 1, hi = lo + 1;
+    while (hi < index->count && index->starts[hi] <= offset) {
+        lo = hi;
+        hi = lo + step;
+        step *= 2;
+    }
+    if (hi > index->count) hi = index->count;
+    *cursor = line_index_search(index, offset, lo, hi);
+    return *cursor + 1;
+}
+
+/* Column of offset within its line, from 1, counted in bytes. */
+static inline size_t line_index_column(const struct line_index *index, size_t offset) {
+    return offset - index->starts[line_index_line(index, offset) - 1] + 1;
+}
+
+/*
+ * Reads all of in into a buffer followed by the two NUL bytes that
+ * yy_scan_buffer needs. Returns NULL if out of memory or on a read error.
+ */
+static inline char *line_index_read_all(FILE *in, size_t *len) {
+    size_t capacity = 1 << 16, used = 0;
+    char *text = malloc(capacity);
+    if (!text) return NULL;
+    for (;;) {
+        if (capacity - used < 2 + 4096) {
+            char *grown = realloc(text, capacity * 2);
+            if (!grown) {
+                free(text);
+                return NULL;
+            }
+            text = grown;
+            capacity *= 2;
+        }
+        size_t n = fread(text + used, 1, capacity - used - 2, in);
+        used += n;
+        if (n == 0) break;
+    }
+    if (ferror(in)) {
+        free(text);
+        return NULL;
+    }
+    text[used] = text[used + 1] = '\0';
+    *len = used;
+    return text;
+}
+
+#endif
@@ -1,16 +1,205 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define OPSCAN_X86 1
+#endif
+
+/*
+ * Byte classes used by the block scanner. Every operator character has
+ * CLS_OP set; characters that can take part in a two-character operator
+ * also get their own bit so the pairs can be matched from adjacent masks.
+ * The masks from M_QUOTE on are only built when comments and literals
+ * are skipped.
+ */
+enum {
+    M_OP, M_PLUS, M_MINUS, M_EQ, M_BANG, M_LT, M_GT, M_AMP, M_PIPE,
+    M_COUNT,
+    M_QUOTE = M_COUNT, M_APOS, M_BSLASH, M_SLASH, M_STAR, M_NL,
+    M_ALL
+};
+
+#define CLS_OP    (1u << M_OP)
+#define CLS_PLUS  (1u << M_PLUS)
+#define CLS_MINUS (1u << M_MINUS)
+#define CLS_EQ    (1u << M_EQ)
+#define CLS_BANG  (1u << M_BANG)
+#define CLS_LT    (1u << M_LT)
+#define CLS_GT    (1u << M_GT)
+#define CLS_AMP   (1u << M_AMP)
+#define CLS_PIPE  (1u << M_PIPE)
+#define CLS_QUOTE  (1u << M_QUOTE)
+#define CLS_APOS   (1u << M_APOS)
+#define CLS_BSLASH (1u << M_BSLASH)
+#define CLS_SLASH  (1u << M_SLASH)
+#define CLS_STAR   (1u << M_STAR)
+#define CLS_NL     (1u << M_NL)
+
+static const uint16_t opClass[256] = {
+    ['+'] = CLS_OP | CLS_PLUS,  ['-'] = CLS_OP | CLS_MINUS,
+    ['='] = CLS_OP | CLS_EQ,    ['!'] = CLS_OP | CLS_BANG,
+    ['<'] = CLS_OP | CLS_LT,    ['>'] = CLS_OP | CLS_GT,
+    ['&'] = CLS_OP | CLS_AMP,   ['|'] = CLS_OP | CLS_PIPE,
+    ['*'] = CLS_OP | CLS_STAR,  ['/'] = CLS_OP | CLS_SLASH,
+    ['%'] = CLS_OP, ['^'] = CLS_OP, ['~'] = CLS_OP,
+    ['"'] = CLS_QUOTE, ['\''] = CLS_APOS, ['\\'] = CLS_BSLASH, ['\n'] = CLS_NL
+};
+
+/* Where the comment- and literal-aware scanner is at a block boundary. */
+typedef enum {
+    LEX_CODE, LEX_STRING, LEX_CHAR, LEX_LINE_COMMENT, LEX_BLOCK_COMMENT,
+    LEX_STATE_COUNT
+} LexState;
+
+/* Operator kinds reported in the histogram, singles first. */
+typedef enum {
+    OP_PLUS, OP_MINUS, OP_STAR, OP_SLASH, OP_PERCENT, OP_ASSIGN, OP_LESS,
+    OP_GREATER, OP_NOT, OP_BITAND, OP_BITOR, OP_XOR, OP_TILDE,
+    OP_INC, OP_DEC, OP_EQ, OP_NE, OP_LE, OP_GE, OP_AND, OP_OR, OP_SHL, OP_SHR,
+    OP_KIND_COUNT
+} OpKind;
+
+static const char *opKindNames[OP_KIND_COUNT] = {
+    "+", "-", "*", "/", "%", "=", "<", ">", "!", "&", "|", "^", "~",
+    "++", "--", "==", "!=", "<=", ">=", "&&", "||", "<<", ">>"
+};
+
+/* Single-character kind of each operator byte. */
+static const uint8_t opSingleKind[256] = {
+    ['+'] = OP_PLUS, ['-'] = OP_MINUS, ['*'] = OP_STAR, ['/'] = OP_SLASH,
+    ['%'] = OP_PERCENT, ['='] = OP_ASSIGN, ['<'] = OP_LESS, ['>'] = OP_GREATER,
+    ['!'] = OP_NOT, ['&'] = OP_BITAND, ['|'] = OP_BITOR, ['^'] = OP_XOR,
+    ['~'] = OP_TILDE
+};
+
+#define BLOCK_SIZE 64
+
+#if defined(__GNUC__)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+#define MAP_WINDOW (64u << 20)    /* bytes mapped at a time for regular files */
+#define READ_BUFFER (1u << 20)    /* read(2) size for pipes and terminals */
+#define MAX_THREADS 256
+#define RECONCILE_SPAN 4096       /* bytes rescanned per step when fixing a chunk start */
+
+#define MAX_OP_KINDS 128          /* operators in a dictionary loaded with -o */
+#define MAX_OP_LEN 16
+#define MAX_DFA_STATES 1024
+#define MAX_BYTE_CLASSES 64
+
+/*
+ * An operator set loaded from a file, compiled into a DFA over byte
+ * classes. State 0 is the start state and a 0 transition means no
+ * operator continues with that byte. Matching is longest-match: the scan
+ * remembers the last accepting state and falls back to it when the DFA
+ * dies, so "<<=" is one operator when the set has it and "<<" "=" when
+ * it does not.
+ */
+typedef struct {
+    int kindCount;
+    char names[MAX_OP_KINDS][MAX_OP_LEN + 1];
+    int stateCount;
+    int classCount;
+    uint8_t byteClass[256];          /* 0 = byte in no operator */
+    uint16_t next[MAX_DFA_STATES][MAX_BYTE_CLASSES];
+    int16_t accept[MAX_DFA_STATES];  /* kind matched in this state, or -1 */
+    bool startByte[256];
+    bool asciiStarts;                /* startLo covers every start byte */
+    uint8_t startLo[16];             /* bit h of startLo[l]: byte 0xhl starts an operator */
+} OpDictionary;
+
+/* Receives each operator found by the dictionary scan, in input order. */
+typedef void (*OperatorFn)(void *ctx, int kind);
+
+/* Streaming state of the operator scanner. */
+typedef struct {
+    uint64_t count;
+    uint64_t pairCarry;   /* byte 0 of the next block closes a two-char operator */
+    bool histogram;       /* also fill kinds[] */
+    uint64_t kinds[MAX_OP_KINDS];
+    const OpDictionary *dict;  /* NULL for the built-in operator set */
+    OperatorFn onOperator;     /* only called when dict is set */
+    void *operatorCtx;
+    uint16_t dfaState;
+    int16_t lastKind;     /* longest operator seen since the token started */
+    uint8_t lastLen;
+    uint8_t pendingLen;
+    uint8_t pending[MAX_OP_LEN];  /* bytes read since the token started */
+    bool lines;           /* also count operators per line */
+    uint32_t *lineOps;    /* operators on each finished line */
+    size_t lineCount, lineCap;
+    uint32_t openLineOps; /* operators so far on the line being scanned */
+    int lastByte;         /* last byte fed, to tell if the input ends with a newline */
+    bool lexical;         /* ignore comments, string and character literals */
+    LexState lexState;
+    uint64_t escapeCarry; /* byte 0 of the next block follows an odd run of backslashes */
+    uint64_t lexSkip;     /* byte 0 of the next block ends a comment delimiter */
+    uint8_t tail[BLOCK_SIZE];
+    size_t tailLen;       /* bytes held back until the byte after them is known */
+} OpScanner;
+
+/* Receives one merged range [start, end) of invalid byte offsets. */
+typedef void (*RangeFn)(void *ctx, uint64_t start, uint64_t end);
+
+/*
+ * Streaming state of the bulk validator. The UTF-8 fields describe the
+ * multibyte character still open at offset, whose lead byte may lie in
+ * an earlier block or piece.
+ */
+typedef struct {
+    uint64_t offset;          /* input offset of the next block */
+    uint64_t invalidBytes;
+    uint64_t rangeCount;
+    uint64_t rangeStart, rangeEnd;  /* invalid range still being extended */
+    RangeFn onRange;
+    void *ctx;
+    uint64_t utf8Errors;      /* malformed sequences so far */
+    uint64_t seqStart;        /* offset of the open character's lead byte */
+    uint8_t need;             /* continuation bytes it still expects */
+    uint8_t contLo, contHi;   /* bounds of the next continuation byte */
+    bool vectorReady;         /* prevBytes hold well-formed UTF-8 */
+    uint8_t prevBytes[32];    /* the 32 bytes before offset */
+    uint8_t tail[BLOCK_SIZE];
+    size_t tailLen;           /* bytes held back until a block is full */
+} Validator;
+
+/* Receives consecutive pieces of an input file. */
+typedef void (*ChunkFn)(void *ctx, const char *buf, size_t len);
+
+/* Fills m[M_*] with one bit per byte of a full 64-byte block. */
+typedef void (*ClassifyFn)(const uint8_t *block, uint64_t m[M_ALL]);
+
+/* Scans nblocks full blocks; p[nblocks * 64] must be readable as lookahead. */
+typedef void (*ScanRangeFn)(OpScanner *s, const uint8_t *p, size_t nblocks);
+
+/* Validates nblocks full blocks. */
+typedef void (*ValidateRangeFn)(Validator *v, const uint8_t *p, size_t nblocks);
 
 bool isArithmeticOperator(char ch) {
-    return (ch == '+' || ch == '-' || ch == '*' || ch == '/' || ch == '%' || 
-            ch == '=' || ch == '<' || ch == '>' || ch == '!' || ch == '&' || 
-            ch == '|' || ch == '^' || ch == '~');
+    return (opClass[(unsigned char)ch] & CLS_OP) != 0;
 }
 
 bool isMultiCharOperator(char *str, int pos) {
-    if (pos < strlen(str) - 1) {
+    if (str[pos] != '\0' && str[pos + 1] != '\0') {
         char current = str[pos];
         char next = str[pos + 1];
         
@@ -29,69 +218,1785 @@ bool isMultiCharOperator(char *str, int pos) {
     return false;
 }
 
+static inline uint64_t followedBy(uint64_t mask, unsigned nextCls, int k) {
+    return (mask >> 1) | ((uint64_t)((nextCls >> k) & 1u) << 63);
+}
+
+#define POPCOUNT(x) ((uint64_t)__builtin_popcountll(x))
+
+/*
+ * Splits a block's operators by kind. Taken pairs are identified by their
+ * first character and the class of the byte after it; singles of the
+ * five characters without a mask of their own are looked up byte by byte.
+ */
+static ALWAYS_INLINE void countKinds(OpScanner *s, const uint8_t *block, const uint64_t m[M_ALL],
+                                     unsigned nextCls, uint64_t taken, uint64_t singles) {
+    uint64_t *k = s->kinds;
+    uint64_t nextEq = followedBy(m[M_EQ], nextCls, M_EQ);
+
+    k[OP_INC] += POPCOUNT(taken & m[M_PLUS]);
+    k[OP_DEC] += POPCOUNT(taken & m[M_MINUS]);
+    k[OP_EQ] += POPCOUNT(taken & m[M_EQ]);
+    k[OP_NE] += POPCOUNT(taken & m[M_BANG]);
+    k[OP_LE] += POPCOUNT(taken & m[M_LT] & nextEq);
+    k[OP_SHL] += POPCOUNT(taken & m[M_LT] & ~nextEq);
+    k[OP_GE] += POPCOUNT(taken & m[M_GT] & nextEq);
+    k[OP_SHR] += POPCOUNT(taken & m[M_GT] & ~nextEq);
+    k[OP_AND] += POPCOUNT(taken & m[M_AMP]);
+    k[OP_OR] += POPCOUNT(taken & m[M_PIPE]);
+
+    k[OP_PLUS] += POPCOUNT(singles & m[M_PLUS]);
+    k[OP_MINUS] += POPCOUNT(singles & m[M_MINUS]);
+    k[OP_ASSIGN] += POPCOUNT(singles & m[M_EQ]);
+    k[OP_NOT] += POPCOUNT(singles & m[M_BANG]);
+    k[OP_LESS] += POPCOUNT(singles & m[M_LT]);
+    k[OP_GREATER] += POPCOUNT(singles & m[M_GT]);
+    k[OP_BITAND] += POPCOUNT(singles & m[M_AMP]);
+    k[OP_BITOR] += POPCOUNT(singles & m[M_PIPE]);
+
+    uint64_t others = singles & ~(m[M_PLUS] | m[M_MINUS] | m[M_EQ] | m[M_BANG] |
+                                  m[M_LT] | m[M_GT] | m[M_AMP] | m[M_PIPE]);
+    while (others) {
+        k[opSingleKind[block[__builtin_ctzll(others)]]]++;
+        others &= others - 1;
+    }
+}
+
+static inline uint64_t bitsFrom(int pos) {
+    return pos >= 64 ? 0 : ~0ULL << pos;
+}
+
+/*
+ * Marks the bytes that follow an odd number of backslashes, carrying an
+ * unfinished run into the next block; this is simdjson's escape finder.
+ */
+static ALWAYS_INLINE uint64_t escapedMask(OpScanner *s, uint64_t backslash) {
+    const uint64_t even = 0x5555555555555555ULL;
+    backslash &= ~s->escapeCarry;
+    uint64_t followsEscape = (backslash << 1) | s->escapeCarry;
+    uint64_t oddStarts = backslash & ~even & ~followsEscape;
+    uint64_t evenStarts = oddStarts + backslash;
+    s->escapeCarry = evenStarts < backslash;
+    uint64_t invert = evenStarts << 1;
+    return (even ^ invert) & followsEscape;
+}
+
+/*
+ * Returns the bytes of a block that are code rather than comment or
+ * literal text. Quotes, comment delimiters and newlines are found as bit
+ * masks, so only the handful of positions where the lexical state can
+ * change are visited; a block of plain code costs a few mask operations.
+ * An unterminated string or character literal ends at the newline.
+ */
+static ALWAYS_INLINE uint64_t codeMask(OpScanner *s, const uint64_t m[M_ALL], unsigned nextCls) {
+    uint64_t escaped = escapedMask(s, m[M_BSLASH]);
+    uint64_t quote = m[M_QUOTE] & ~escaped;
+    uint64_t apos = m[M_APOS] & ~escaped;
+    uint64_t slashNext = followedBy(m[M_SLASH], nextCls, M_SLASH);
+    uint64_t starNext = followedBy(m[M_STAR], nextCls, M_STAR);
+    uint64_t opens = m[M_SLASH] & (slashNext | starNext);
+    uint64_t done = s->lexSkip;
+    int codeStart = (int)s->lexSkip;
+
+    s->lexSkip = 0;
+    if (s->lexState == LEX_CODE && !((quote | apos | opens) & ~done)) return ~done;
+
+    uint64_t newline = m[M_NL] & ~escaped;
+    uint64_t events[LEX_STATE_COUNT];
+    events[LEX_CODE] = quote | apos | opens;
+    events[LEX_STRING] = quote | newline;
+    events[LEX_CHAR] = apos | newline;
+    events[LEX_LINE_COMMENT] = newline;
+    events[LEX_BLOCK_COMMENT] = m[M_STAR] & slashNext;
+
+    uint64_t code = 0;
+    uint64_t pending;
+    while ((pending = events[s->lexState] & ~done) != 0) {
+        int pos = __builtin_ctzll(pending);
+        uint64_t bit = 1ULL << pos;
+        done |= bit | (bit - 1);
+
+        switch (s->lexState) {
+        case LEX_CODE:
+            code |= bitsFrom(codeStart) & (bit - 1);
+            if (bit & quote) {
+                s->lexState = LEX_STRING;
+            } else if (bit & apos) {
+                s->lexState = LEX_CHAR;
+            } else if (bit & slashNext) {
+                s->lexState = LEX_LINE_COMMENT;
+            } else {
+                /* the '*' of the opener cannot also close the comment */
+                s->lexState = LEX_BLOCK_COMMENT;
+                done |= bit << 1;
+                if (pos == 63) s->lexSkip = 1;
+            }
+            break;
+        case LEX_STRING:
+        case LEX_CHAR:
+            s->lexState = LEX_CODE;
+            codeStart = (bit & newline) ? pos : pos + 1;
+            break;
+        case LEX_LINE_COMMENT:
+            s->lexState = LEX_CODE;
+            codeStart = pos;
+            break;
+        default:
+            s->lexState = LEX_CODE;
+            codeStart = pos + 2;
+            done |= bit << 1;
+            if (pos == 63) s->lexSkip = 1;
+            break;
+        }
+    }
+    if (s->lexState == LEX_CODE) code |= bitsFrom(codeStart);
+    return code;
+}
+
+static void closeLine(OpScanner *s) {
+    if (s->lineCount == s->lineCap) {
+        size_t cap = s->lineCap ? s->lineCap * 2 : 4096;
+        uint32_t *grown = realloc(s->lineOps, cap * sizeof(*grown));
+        if (!grown) {
+            fprintf(stderr, "Error: Out of memory for per-line counts\n");
+            exit(1);
+        }
+        s->lineOps = grown;
+        s->lineCap = cap;
+    }
+    s->lineOps[s->lineCount++] = s->openLineOps;
+    s->openLineOps = 0;
+}
+
+/* Adds the operators starting at the bits of ops to their lines. */
+static ALWAYS_INLINE void countLines(OpScanner *s, uint64_t ops, uint64_t newlines) {
+    while (newlines) {
+        uint64_t upto = newlines ^ (newlines - 1);
+        s->openLineOps += (uint32_t)__builtin_popcountll(ops & upto);
+        ops &= ~upto;
+        closeLine(s);
+        newlines &= newlines - 1;
+    }
+    s->openLineOps += (uint32_t)__builtin_popcountll(ops);
+}
+
+static ALWAYS_INLINE void dictEmit(OpScanner *s, int kind) {
+    s->count++;
+    if (s->histogram) s->kinds[kind]++;
+    if (s->onOperator) s->onOperator(s->operatorCtx, kind);
+    s->openLineOps++;
+}
+
+static void dictStep(OpScanner *s, uint8_t c);
+
+/*
+ * The DFA cannot go on: emit the longest operator seen, if any, and
+ * rescan the bytes read after it. With no match only the first byte is
+ * dropped, which is what makes the scan longest-match from every start.
+ */
+static void dictBacktrack(OpScanner *s) {
+    uint8_t replay[MAX_OP_LEN];
+    int keep = s->lastLen > 0 ? s->lastLen : 1;
+    int n = s->pendingLen - keep;
+
+    if (s->lastLen > 0) dictEmit(s, s->lastKind);
+    memcpy(replay, s->pending + keep, (size_t)n);
+    s->dfaState = 0;
+    s->pendingLen = 0;
+    s->lastLen = 0;
+    for (int i = 0; i < n; i++) dictStep(s, replay[i]);
+}
+
+static ALWAYS_INLINE void dictAdvance(OpScanner *s, uint16_t next, uint8_t c) {
+    s->dfaState = next;
+    s->pending[s->pendingLen++] = c;
+    if (s->dict->accept[next] >= 0) {
+        s->lastKind = s->dict->accept[next];
+        s->lastLen = s->pendingLen;
+    }
+}
+
+static void dictStep(OpScanner *s, uint8_t c) {
+    const OpDictionary *d = s->dict;
+    for (;;) {
+        uint16_t next = d->next[s->dfaState][d->byteClass[c]];
+        if (next) {
+            dictAdvance(s, next, c);
+            return;
+        }
+        if (s->dfaState == 0) return;
+        if (s->lastLen == s->pendingLen) {
+            /* the usual case: the operator just read is complete */
+            dictEmit(s, s->lastKind);
+            s->dfaState = 0;
+            s->pendingLen = 0;
+            s->lastLen = 0;
+            continue;
+        }
+        dictBacktrack(s);
+    }
+}
+
+/* Ends the current token: the next byte cannot extend it (end of input or not code). */
+static void dictBreak(OpScanner *s) {
+    while (s->dfaState != 0) dictBacktrack(s);
+}
+
+/*
+ * Runs the dictionary DFA over bytes from..to-1 of a block. Between
+ * tokens the scan jumps straight to the next byte that can start an
+ * operator, so identifier and whitespace runs cost one mask test.
+ */
+static ALWAYS_INLINE void dictScanBytes(OpScanner *s, const uint8_t *block, uint64_t starts,
+                                        uint64_t code, int from, int to) {
+    int pos = from;
+    while (pos < to) {
+        if (s->dfaState == 0) {
+            uint64_t candidates = starts & code & bitsFrom(pos);
+            if (!candidates) return;
+            pos = __builtin_ctzll(candidates);
+            if (pos >= to) return;
+        }
+        if ((code >> pos) & 1) {
+            uint8_t c = block[pos];
+            uint16_t next = s->dict->next[s->dfaState][s->dict->byteClass[c]];
+            if (next) {
+                dictAdvance(s, next, c);
+            } else {
+                dictStep(s, c);
+            }
+        } else {
+            dictBreak(s);
+        }
+        pos++;
+    }
+}
+
+/*
+ * With per-line counts the block is cut after each newline. No operator
+ * contains a newline, so once the newline is fed every operator of the
+ * line has been emitted.
+ */
+static ALWAYS_INLINE void dictScanBlock(OpScanner *s, const uint8_t *block, uint64_t starts,
+                                        uint64_t code, uint64_t newlines) {
+    int from = 0;
+    if (s->lines) {
+        while (newlines) {
+            int pos = __builtin_ctzll(newlines);
+            dictScanBytes(s, block, starts, code, from, pos + 1);
+            if (s->dfaState != 0) dictBreak(s);
+            closeLine(s);
+            from = pos + 1;
+            newlines &= newlines - 1;
+        }
+    }
+    dictScanBytes(s, block, starts, code, from, BLOCK_SIZE);
+}
+
+/*
+ * Counts the operators in one block from its class masks. The old code
+ * scans left to right and takes a two-character operator whenever one
+ * starts at the current byte, so inside a run of consecutive pair starts
+ * only every other position is taken, counting from the start of the run.
+ * Runs are split by parity with an add-carry, the same trick simdjson
+ * uses for odd-length backslash sequences.
+ */
+static ALWAYS_INLINE void scanMasks(OpScanner *s, const uint8_t *block,
+                                     uint64_t m[M_ALL], unsigned nextCls) {
+    const uint64_t even = 0x5555555555555555ULL;
+    if (s->dict) {
+        dictScanBlock(s, block, m[M_OP], s->lexical ? codeMask(s, m, nextCls) : ~0ULL, m[M_NL]);
+        return;
+    }
+    if (s->lexical) {
+        uint64_t code = codeMask(s, m, nextCls);
+        for (int k = 0; k < M_COUNT; k++) m[k] &= code;
+    }
+
+    uint64_t pairs =
+        (m[M_PLUS] & followedBy(m[M_PLUS], nextCls, M_PLUS)) |
+        (m[M_MINUS] & followedBy(m[M_MINUS], nextCls, M_MINUS)) |
+        ((m[M_EQ] | m[M_BANG] | m[M_LT] | m[M_GT]) & followedBy(m[M_EQ], nextCls, M_EQ)) |
+        (m[M_AMP] & followedBy(m[M_AMP], nextCls, M_AMP)) |
+        (m[M_PIPE] & followedBy(m[M_PIPE], nextCls, M_PIPE)) |
+        (m[M_LT] & followedBy(m[M_LT], nextCls, M_LT)) |
+        (m[M_GT] & followedBy(m[M_GT], nextCls, M_GT));
+
+    pairs &= ~s->pairCarry;
+    uint64_t starts = pairs & ~(pairs << 1);
+    uint64_t evenRuns = pairs & ~(pairs + (starts & even));
+    uint64_t oddRuns = pairs & ~evenRuns;
+    uint64_t taken = (evenRuns & even) | (oddRuns & ~even);
+    uint64_t seconds = (taken << 1) | s->pairCarry;
+
+    s->count += (uint64_t)__builtin_popcountll(m[M_OP] & ~seconds);
+    s->pairCarry = taken >> 63;
+    if (s->lines) countLines(s, m[M_OP] & ~seconds, m[M_NL]);
+    if (s->histogram) countKinds(s, block, m, nextCls, taken, m[M_OP] & ~seconds & ~taken);
+}
+
+/* Builds masks first..last-1 straight from the class table. */
+static ALWAYS_INLINE void classifyTable(const uint8_t *block, uint64_t m[M_ALL], int first, int last) {
+    unsigned wanted = (1u << last) - (1u << first);
+    for (int k = first; k < last; k++) m[k] = 0;
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        unsigned cls = opClass[block[i]] & wanted;
+        if (!cls) continue;
+        for (int k = first; k < last; k++) {
+            m[k] |= (uint64_t)((cls >> k) & 1u) << i;
+        }
+    }
+}
+
+static ALWAYS_INLINE void classifyScalar(const uint8_t *block, uint64_t m[M_ALL]) {
+    classifyTable(block, m, 0, M_COUNT);
+}
+
+static ALWAYS_INLINE void classifyLexScalar(const uint8_t *block, uint64_t m[M_ALL]) {
+    classifyTable(block, m, M_COUNT, M_ALL);
+}
+
+/* With a dictionary, m[M_OP] marks the bytes that can start an operator. */
+static ALWAYS_INLINE void classifyDictScalar(const OpDictionary *d, const uint8_t *block, uint64_t m[M_ALL]) {
+    uint64_t starts = 0;
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        starts |= (uint64_t)d->startByte[block[i]] << i;
+    }
+    m[M_OP] = starts;
+}
+
+#ifdef OPSCAN_X86
+__attribute__((target("sse2,popcnt")))
+static ALWAYS_INLINE uint64_t eqMask128(const __m128i v[4], char c, __m128i *any) {
+    const __m128i needle = _mm_set1_epi8(c);
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i eq = _mm_cmpeq_epi8(v[i], needle);
+        any[i] = _mm_or_si128(any[i], eq);
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(eq) << (i * 16);
+    }
+    return mask;
+}
+
+__attribute__((target("sse2,popcnt")))
+static ALWAYS_INLINE void classifySse2(const uint8_t *block, uint64_t m[M_ALL]) {
+    __m128i v[4], any[4];
+    for (int i = 0; i < 4; i++) {
+        v[i] = _mm_loadu_si128((const __m128i *)(block + i * 16));
+        any[i] = _mm_setzero_si128();
+    }
+    m[M_PLUS] = eqMask128(v, '+', any);
+    m[M_MINUS] = eqMask128(v, '-', any);
+    m[M_EQ] = eqMask128(v, '=', any);
+    m[M_BANG] = eqMask128(v, '!', any);
+    m[M_LT] = eqMask128(v, '<', any);
+    m[M_GT] = eqMask128(v, '>', any);
+    m[M_AMP] = eqMask128(v, '&', any);
+    m[M_PIPE] = eqMask128(v, '|', any);
+    eqMask128(v, '*', any);
+    eqMask128(v, '/', any);
+    eqMask128(v, '%', any);
+    eqMask128(v, '^', any);
+    eqMask128(v, '~', any);
+
+    m[M_OP] = 0;
+    for (int i = 0; i < 4; i++) {
+        m[M_OP] |= (uint64_t)(uint16_t)_mm_movemask_epi8(any[i]) << (i * 16);
+    }
+}
+
+__attribute__((target("sse2,popcnt")))
+static ALWAYS_INLINE void classifyLexSse2(const uint8_t *block, uint64_t m[M_ALL]) {
+    __m128i v[4], any[4];
+    for (int i = 0; i < 4; i++) {
+        v[i] = _mm_loadu_si128((const __m128i *)(block + i * 16));
+        any[i] = _mm_setzero_si128();
+    }
+    m[M_QUOTE] = eqMask128(v, '"', any);
+    m[M_APOS] = eqMask128(v, '\'', any);
+    m[M_BSLASH] = eqMask128(v, '\\', any);
+    m[M_SLASH] = eqMask128(v, '/', any);
+    m[M_STAR] = eqMask128(v, '*', any);
+    m[M_NL] = eqMask128(v, '\n', any);
+}
+
+__attribute__((target("avx2,popcnt")))
+static ALWAYS_INLINE uint64_t eqMask256(__m256i lo, __m256i hi, char c) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    uint32_t a = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle));
+    uint32_t b = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle));
+    return (uint64_t)a | ((uint64_t)b << 32);
+}
+
+/*
+ * The AVX2 kernel classifies "is an operator" with a nibble lookup:
+ * every operator byte has a high nibble of 2, 3, 5 or 7, so one shuffle
+ * maps the high nibble to a bit and a second maps the low nibble to the
+ * set of high nibbles it is valid with.
+ */
+__attribute__((target("avx2,popcnt")))
+static ALWAYS_INLINE uint32_t opMask256(__m256i v) {
+    const __m256i hiTable = _mm256_setr_epi8(
+        0, 0, 1, 2, 0, 4, 0, 8, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 1, 2, 0, 4, 0, 8, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i loTable = _mm256_setr_epi8(
+        0, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 10, 3, 14, 1,
+        0, 1, 0, 0, 0, 1, 1, 0, 0, 0, 1, 1, 10, 3, 14, 1);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i hi = _mm256_shuffle_epi8(hiTable, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    __m256i lo = _mm256_shuffle_epi8(loTable, _mm256_and_si256(v, nibble));
+    __m256i none = _mm256_cmpeq_epi8(_mm256_and_si256(hi, lo), _mm256_setzero_si256());
+    return ~(uint32_t)_mm256_movemask_epi8(none);
+}
+
+/*
+ * Start bytes of a dictionary whose operators begin with ASCII are found
+ * with the same nibble lookup as opMask256: the high nibble (0-7) picks a
+ * bit and startLo says which high nibbles each low nibble is valid with.
+ */
+__attribute__((target("avx2,popcnt")))
+static ALWAYS_INLINE void classifyDictAvx2(const OpDictionary *d, const uint8_t *block, uint64_t m[M_ALL]) {
+    if (!d->asciiStarts) {
+        classifyDictScalar(d, block, m);
+        return;
+    }
+    const __m256i hiTable = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i loTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)d->startLo));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    uint64_t starts = 0;
+
+    for (int half = 0; half < 2; half++) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(block + half * 32));
+        __m256i hi = _mm256_shuffle_epi8(hiTable, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        __m256i lo = _mm256_shuffle_epi8(loTable, _mm256_and_si256(v, nibble));
+        __m256i none = _mm256_cmpeq_epi8(_mm256_and_si256(hi, lo), _mm256_setzero_si256());
+        starts |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(none) << (half * 32);
+    }
+    m[M_OP] = starts;
+}
+
+__attribute__((target("avx2,popcnt")))
+static ALWAYS_INLINE void classifyAvx2(const uint8_t *block, uint64_t m[M_ALL]) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *)block);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+
+    m[M_OP] = (uint64_t)opMask256(lo) | ((uint64_t)opMask256(hi) << 32);
+    m[M_PLUS] = eqMask256(lo, hi, '+');
+    m[M_MINUS] = eqMask256(lo, hi, '-');
+    m[M_EQ] = eqMask256(lo, hi, '=');
+    m[M_BANG] = eqMask256(lo, hi, '!');
+    m[M_LT] = eqMask256(lo, hi, '<');
+    m[M_GT] = eqMask256(lo, hi, '>');
+    m[M_AMP] = eqMask256(lo, hi, '&');
+    m[M_PIPE] = eqMask256(lo, hi, '|');
+}
+
+__attribute__((target("avx2,popcnt")))
+static ALWAYS_INLINE void classifyLexAvx2(const uint8_t *block, uint64_t m[M_ALL]) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *)block);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+
+    m[M_QUOTE] = eqMask256(lo, hi, '"');
+    m[M_APOS] = eqMask256(lo, hi, '\'');
+    m[M_BSLASH] = eqMask256(lo, hi, '\\');
+    m[M_SLASH] = eqMask256(lo, hi, '/');
+    m[M_STAR] = eqMask256(lo, hi, '*');
+    m[M_NL] = eqMask256(lo, hi, '\n');
+}
+#endif
+
+/* One block loop per kernel so the classifier and scanMasks inline together. */
+#define DEFINE_SCAN_RANGE(name, classify, classifyLex, classifyDict, attrs) \
+    attrs static void name(OpScanner *s, const uint8_t *p, size_t nblocks) { \
+        for (size_t b = 0; b < nblocks; b++, p += BLOCK_SIZE) {          \
+            uint64_t m[M_ALL];                                            \
+            if (s->dict) {                                                \
+                classifyDict(s->dict, p, m);                              \
+            } else {                                                      \
+                classify(p, m);                                           \
+            }                                                             \
+            if (s->lexical || s->lines) classifyLex(p, m);                \
+            scanMasks(s, p, m, opClass[p[BLOCK_SIZE]]);                   \
+        }                                                                 \
+    }
+
+DEFINE_SCAN_RANGE(scanRangeScalar, classifyScalar, classifyLexScalar, classifyDictScalar, )
+#ifdef OPSCAN_X86
+DEFINE_SCAN_RANGE(scanRangeSse2, classifySse2, classifyLexSse2, classifyDictScalar,
+                  __attribute__((target("sse2,popcnt"))))
+DEFINE_SCAN_RANGE(scanRangeAvx2, classifyAvx2, classifyLexAvx2, classifyDictAvx2,
+                  __attribute__((target("avx2,popcnt"))))
+#endif
+
+/*
+ * Bulk validation (TASK 5 over whole inputs). An ASCII byte is valid when
+ * it is alphanumeric, whitespace or an operator character; a byte above
+ * 127 is valid when it belongs to a well-formed UTF-8 character. Invalid
+ * bytes are reported as merged [start, end) ranges of offsets.
+ */
+static bool validAscii[256];
+static uint8_t validLo[16];   /* bit h of validLo[l]: byte 0xhl is valid ASCII */
+
+static void buildValidTables(void) {
+    for (int c = 0; c < 128; c++) {
+        validAscii[c] = isalnum(c) || isspace(c) || (opClass[c] & CLS_OP);
+        if (validAscii[c]) validLo[c & 0x0F] |= (uint8_t)(1u << (c >> 4));
+    }
+}
+
+static void flushRange(Validator *v) {
+    if (v->rangeEnd == v->rangeStart) return;
+    v->rangeCount++;
+    if (v->onRange) v->onRange(v->ctx, v->rangeStart, v->rangeEnd);
+}
+
+/* Marks [start, end) invalid; calls come in offset order. */
+static void markInvalid(Validator *v, uint64_t start, uint64_t end) {
+    v->invalidBytes += end - start;
+    if (start != v->rangeEnd || v->rangeStart == v->rangeEnd) {
+        flushRange(v);
+        v->rangeStart = start;
+    }
+    v->rangeEnd = end;
+}
+
+/* Marks the runs of set bits in mask, bit i being byte base + i. */
+static ALWAYS_INLINE void markMask(Validator *v, uint64_t base, uint64_t mask) {
+    while (mask) {
+        int start = __builtin_ctzll(mask);
+        uint64_t rest = ~(mask >> start);
+        int len = rest ? __builtin_ctzll(rest) : BLOCK_SIZE - start;
+        markInvalid(v, base + (uint64_t)start, base + (uint64_t)(start + len));
+        mask = start + len < BLOCK_SIZE ? mask & (~0ULL << (start + len)) : 0;
+    }
+}
+
+/* Opens a character at lead byte c; false if c cannot start one. */
+static ALWAYS_INLINE bool utf8Lead(Validator *v, uint8_t c) {
+    v->contLo = 0x80;
+    v->contHi = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF) {
+        v->need = 1;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        v->need = 2;
+        if (c == 0xE0) v->contLo = 0xA0;   /* overlong */
+        if (c == 0xED) v->contHi = 0x9F;   /* surrogates */
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        v->need = 3;
+        if (c == 0xF0) v->contLo = 0x90;   /* overlong */
+        if (c == 0xF4) v->contHi = 0x8F;   /* above U+10FFFF */
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Byte-at-a-time decoder. A malformed character makes its lead and the
+ * continuation bytes read so far invalid, and the byte that broke it is
+ * decoded again as the start of a new character.
+ */
+static ALWAYS_INLINE void validateByte(Validator *v, uint64_t pos, uint8_t c) {
+    if (v->need > 0) {
+        if (c >= v->contLo && c <= v->contHi) {
+            v->contLo = 0x80;
+            v->contHi = 0xBF;
+            v->need--;
+            return;
+        }
+        v->utf8Errors++;
+        v->need = 0;
+        markInvalid(v, v->seqStart, pos);
+    }
+    if (c < 0x80) {
+        if (!validAscii[c]) markInvalid(v, pos, pos + 1);
+    } else if (utf8Lead(v, c)) {
+        v->seqStart = pos;
+    } else {
+        v->utf8Errors++;
+        markInvalid(v, pos, pos + 1);
+    }
+}
+
+static void validateBytes(Validator *v, const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; i++) validateByte(v, v->offset + i, p[i]);
+    v->offset += n;
+}
+
+/* Reopens the character left open by a block that decoded cleanly. */
+static void utf8StateFromTail(Validator *v, const uint8_t *block) {
+    v->need = 0;
+    for (int back = 1; back <= 3; back++) {
+        uint8_t c = block[BLOCK_SIZE - back];
+        if (c < 0x80) return;
+        if (c < 0xC0) continue;
+        int len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+        if (len > back) {
+            if (!utf8Lead(v, c)) {
+                /* C0, C1 or F5-FF as the last byte: the next byte rejects it */
+                v->contLo = 0xFF;
+                v->contHi = 0x00;
+            }
+            v->need = (uint8_t)(len - back);
+            if (back > 1) {
+                v->contLo = 0x80;
+                v->contHi = 0xBF;
+            }
+            v->seqStart = v->offset - (uint64_t)back;
+        }
+        return;
+    }
+}
+
+static void validateRangeScalar(Validator *v, const uint8_t *p, size_t nblocks) {
+    for (size_t b = 0; b < nblocks; b++, p += BLOCK_SIZE) {
+        uint64_t high = 0;
+        for (int i = 0; i < BLOCK_SIZE; i += 8) {
+            uint64_t word;
+            memcpy(&word, p + i, sizeof(word));
+            high |= word & 0x8080808080808080ULL;
+        }
+        if (high || v->need > 0) {
+            validateBytes(v, p, BLOCK_SIZE);
+            continue;
+        }
+        uint64_t bad = 0;
+        for (int i = 0; i < BLOCK_SIZE; i++) {
+            bad |= (uint64_t)!validAscii[p[i]] << i;
+        }
+        markMask(v, v->offset, bad);
+        v->offset += BLOCK_SIZE;
+    }
+}
+
+#ifdef OPSCAN_X86
+/* Nibble lookup of valid ASCII bytes, the same scheme as opMask256. */
+__attribute__((target("avx2,popcnt")))
+static ALWAYS_INLINE uint32_t validMask256(__m256i v, __m256i loTable) {
+    const __m256i hiTable = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i hi = _mm256_shuffle_epi8(hiTable, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    __m256i lo = _mm256_shuffle_epi8(loTable, _mm256_and_si256(v, nibble));
+    __m256i none = _mm256_cmpeq_epi8(_mm256_and_si256(hi, lo), _mm256_setzero_si256());
+    return ~(uint32_t)_mm256_movemask_epi8(none);
+}
+
+#define UTF8_TOO_SHORT   (1 << 0)
+#define UTF8_TOO_LONG    (1 << 1)
+#define UTF8_OVERLONG_3  (1 << 2)
+#define UTF8_TOO_LARGE   (1 << 3)
+#define UTF8_SURROGATE   (1 << 4)
+#define UTF8_OVERLONG_2  (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4  (1 << 6)
+#define UTF8_TWO_CONTS   (1 << 7)
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+/*
+ * UTF-8 errors in 32 bytes following prev, after Keiser and Lemire's
+ * lookup algorithm: three nibble lookups of each byte and the one before
+ * it flag every bad two-byte combination, and a saturating subtraction
+ * checks that the third and fourth bytes of long characters are
+ * continuations. A character cut off at the end shows up in the next call.
+ */
+__attribute__((target("avx2,popcnt")))
+static ALWAYS_INLINE __m256i utf8Errors256(__m256i input, __m256i prev) {
+    const __m256i byte1High = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4));
+    const __m256i byte1Low = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000));
+    const __m256i byte2High = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    __m256i joined = _mm256_permute2x128_si256(prev, input, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(input, joined, 15);
+    __m256i prev2 = _mm256_alignr_epi8(input, joined, 14);
+    __m256i prev3 = _mm256_alignr_epi8(input, joined, 13);
+
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(byte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+            _mm256_shuffle_epi8(byte1Low, _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(byte2High, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i mustContinue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(mustContinue, special);
+}
+
+/*
+ * All-ASCII blocks only need the valid-byte lookup. Other blocks are
+ * checked for UTF-8 errors with vectors, and only a block with an error
+ * (or the one after it, whose first bytes depend on how the error was
+ * resolved) goes through the byte decoder to find the exact offsets.
+ */
+__attribute__((target("avx2,popcnt")))
+static void validateRangeAvx2(Validator *v, const uint8_t *p, size_t nblocks) {
+    const __m256i loTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)validLo));
+    __m256i prev = _mm256_loadu_si256((const __m256i *)v->prevBytes);
+
+    for (size_t b = 0; b < nblocks; b++, p += BLOCK_SIZE) {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)p);
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(p + 32));
+        uint64_t high = (uint64_t)(uint32_t)_mm256_movemask_epi8(lo) |
+                        ((uint64_t)(uint32_t)_mm256_movemask_epi8(hi) << 32);
+        uint64_t valid = (uint64_t)validMask256(lo, loTable) | ((uint64_t)validMask256(hi, loTable) << 32);
+        bool clean;
+
+        if (high == 0 && v->need == 0) {
+            clean = true;
+        } else if (v->vectorReady) {
+            __m256i errors = _mm256_or_si256(utf8Errors256(lo, prev), utf8Errors256(hi, lo));
+            clean = _mm256_testz_si256(errors, errors);
+        } else {
+            clean = false;
+        }
+
+        if (clean) {
+            markMask(v, v->offset, ~(valid | high));
+            v->offset += BLOCK_SIZE;
+            if (high) utf8StateFromTail(v, p);
+            v->vectorReady = true;
+        } else {
+            uint64_t errorsBefore = v->utf8Errors;
+            validateBytes(v, p, BLOCK_SIZE);
+            v->vectorReady = v->utf8Errors == errorsBefore;
+        }
+        prev = hi;
+    }
+    _mm256_storeu_si256((__m256i *)v->prevBytes, prev);
+}
+#endif
+
+typedef void (*ClassifyDictFn)(const OpDictionary *d, const uint8_t *block, uint64_t m[M_ALL]);
+
+typedef struct {
+    const char *name;
+    ClassifyFn classify;
+    ClassifyFn classifyLex;
+    ClassifyDictFn classifyDict;
+    ScanRangeFn scanRange;
+    ValidateRangeFn validateRange;
+} ScanKernel;
+
+static const ScanKernel kernels[] = {
+#ifdef OPSCAN_X86
+    { "avx2", classifyAvx2, classifyLexAvx2, classifyDictAvx2, scanRangeAvx2, validateRangeAvx2 },
+    { "sse2", classifySse2, classifyLexSse2, classifyDictScalar, scanRangeSse2, validateRangeScalar },
+#endif
+    { "scalar", classifyScalar, classifyLexScalar, classifyDictScalar, scanRangeScalar, validateRangeScalar }
+};
+
+static bool kernelSupported(const ScanKernel *kernel) {
+#ifdef OPSCAN_X86
+    if (!__builtin_cpu_supports("popcnt")) return kernel->scanRange == scanRangeScalar;
+    if (kernel->scanRange == scanRangeAvx2) return __builtin_cpu_supports("avx2");
+    if (kernel->scanRange == scanRangeSse2) return __builtin_cpu_supports("sse2");
+#endif
+    return kernel->scanRange == scanRangeScalar;
+}
+
+static const ScanKernel *activeKernel = NULL;
+static bool skipCommentsAndLiterals = false;
+static const char *reportFormat = NULL;   /* "csv" or "json" with -r */
+static OpDictionary loadedDictionary;
+static OpDictionary builtinDictionary;    /* the built-in set as a DFA, for scans that list operators */
+static const OpDictionary *activeDictionary = NULL;
+
+static int kindCount(void) {
+    return activeDictionary ? activeDictionary->kindCount : OP_KIND_COUNT;
+}
+
+static const char *kindName(int kind) {
+    return activeDictionary ? activeDictionary->names[kind] : opKindNames[kind];
+}
+
+/* Adds one operator to the dictionary's DFA. Returns false if a limit is hit. */
+static bool addDictionaryOperator(OpDictionary *d, const char *op) {
+    size_t len = strlen(op);
+    int state = 0;
+
+    if (len > MAX_OP_LEN) {
+        fprintf(stderr, "Error: Operator '%s' is longer than %d bytes\n", op, MAX_OP_LEN);
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = (uint8_t)op[i];
+        if (d->byteClass[c] == 0) {
+            if (d->classCount == MAX_BYTE_CLASSES) {
+                fprintf(stderr, "Error: Operators use more than %d distinct bytes\n", MAX_BYTE_CLASSES - 1);
+                return false;
+            }
+            d->byteClass[c] = (uint8_t)d->classCount++;
+        }
+        uint16_t *slot = &d->next[state][d->byteClass[c]];
+        if (*slot == 0) {
+            if (d->stateCount == MAX_DFA_STATES) {
+                fprintf(stderr, "Error: Operator set needs more than %d DFA states\n", MAX_DFA_STATES);
+                return false;
+            }
+            d->accept[d->stateCount] = -1;
+            *slot = (uint16_t)d->stateCount++;
+        }
+        state = *slot;
+    }
+    if (d->accept[state] >= 0) return true;   /* listed twice */
+    if (d->kindCount == MAX_OP_KINDS) {
+        fprintf(stderr, "Error: More than %d operators\n", MAX_OP_KINDS);
+        return false;
+    }
+
+    uint8_t first = (uint8_t)op[0];
+    d->startByte[first] = true;
+    if (first < 0x80) {
+        d->startLo[first & 0x0F] |= (uint8_t)(1u << (first >> 4));
+    } else {
+        d->asciiStarts = false;
+    }
+    strcpy(d->names[d->kindCount], op);
+    d->accept[state] = (int16_t)d->kindCount++;
+    return true;
+}
+
+static void dictionaryInit(OpDictionary *d) {
+    memset(d, 0, sizeof(*d));
+    d->stateCount = 1;
+    d->classCount = 1;
+    d->accept[0] = -1;
+    d->asciiStarts = true;
+}
+
+/*
+ * The built-in operators in OpKind order, so a kind found by the DFA is
+ * the same kind the mask scanner counts. Longest match over this set
+ * pairs characters from the left exactly as the mask scanner does.
+ */
+static const OpDictionary *builtinAsDictionary(void) {
+    if (builtinDictionary.kindCount == 0) {
+        dictionaryInit(&builtinDictionary);
+        for (int k = 0; k < OP_KIND_COUNT; k++) addDictionaryOperator(&builtinDictionary, opKindNames[k]);
+    }
+    return &builtinDictionary;
+}
+
+/*
+ * Loads an operator set: operators are separated by whitespace, and a
+ * line starting with "# " is a comment, so "#" and "##" can still be
+ * listed as operators. Because the DFA is a trie over the operators, it
+ * is already deterministic and minimal enough for sets of this size.
+ */
+static bool loadOperatorDictionary(const char *path, OpDictionary *d) {
+    FILE *file = fopen(path, "r");
+    char line[256];
+
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open operator file %s\n", path);
+        return false;
+    }
+    dictionaryInit(d);
+
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' && (line[1] == ' ' || line[1] == '\n' || line[1] == '\0')) continue;
+        for (char *op = strtok(line, " \t\r\n"); op && ok; op = strtok(NULL, " \t\r\n")) {
+            ok = addDictionaryOperator(d, op);
+        }
+    }
+    fclose(file);
+    if (ok && d->kindCount == 0) {
+        fprintf(stderr, "Error: No operators in %s\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+/* Picks the named kernel, or the widest one the CPU supports when name is NULL. */
+static const ScanKernel *selectKernel(const char *name) {
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        if (name && strcmp(name, kernels[i].name) != 0) continue;
+        if (kernelSupported(&kernels[i])) {
+            activeKernel = &kernels[i];
+            return activeKernel;
+        }
+    }
+    return NULL;
+}
+
+/* Scans n <= 64 bytes; next is the byte after them, or -1 at end of input. */
+static void scanBlock(OpScanner *s, const uint8_t *p, size_t n, int next) {
+    uint64_t m[M_ALL];
+    unsigned nextCls = next < 0 ? 0 : opClass[next];
+
+    uint8_t padded[BLOCK_SIZE];
+
+    if (n < BLOCK_SIZE) {
+        memset(padded, 0, sizeof(padded));
+        memcpy(padded, p, n);
+        p = padded;
+    }
+    if (s->dict) {
+        activeKernel->classifyDict(s->dict, p, m);
+    } else {
+        activeKernel->classify(p, m);
+    }
+    if (s->lexical || s->lines) activeKernel->classifyLex(p, m);
+    scanMasks(s, p, m, nextCls);
+}
+
+/* Scans p[0..len) in one go; next is the byte after it, or -1 at end of input. */
+static void scanSpan(OpScanner *s, const uint8_t *p, size_t len, int next) {
+    if (len > BLOCK_SIZE) {
+        size_t nblocks = (len - 1) / BLOCK_SIZE;
+        activeKernel->scanRange(s, p, nblocks);
+        p += nblocks * BLOCK_SIZE;
+        len -= nblocks * BLOCK_SIZE;
+    }
+    if (len > 0) scanBlock(s, p, len, next);
+}
+
+void opScannerInit(OpScanner *s) {
+    memset(s, 0, sizeof(*s));
+    s->lexical = skipCommentsAndLiterals;
+    s->dict = activeDictionary;
+    s->lines = reportFormat != NULL;
+    s->lastByte = -1;
+    if (!activeKernel) selectKernel(NULL);
+}
+
+void opScannerRelease(OpScanner *s) {
+    free(s->lineOps);
+    s->lineOps = NULL;
+    s->lineCount = s->lineCap = 0;
+}
+
+/*
+ * Feeds the next piece of the input. Every block needs the byte after it
+ * to see a two-character operator, so up to one block is held back in
+ * s->tail and completed from the start of the following piece; an
+ * operator such as "<<" split across two pieces is counted once.
+ */
+void opScannerFeed(OpScanner *s, const char *buf, size_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+
+    if (len > 0) s->lastByte = p[len - 1];
+    if (s->tailLen > 0) {
+        size_t take = BLOCK_SIZE - s->tailLen;
+        if (take > len) take = len;
+        memcpy(s->tail + s->tailLen, p, take);
+        s->tailLen += take;
+        p += take;
+        len -= take;
+        if (s->tailLen < BLOCK_SIZE || len == 0) return;
+        scanBlock(s, s->tail, BLOCK_SIZE, p[0]);
+        s->tailLen = 0;
+    }
+    if (len > BLOCK_SIZE) {
+        size_t nblocks = (len - 1) / BLOCK_SIZE;
+        activeKernel->scanRange(s, p, nblocks);
+        p += nblocks * BLOCK_SIZE;
+        len -= nblocks * BLOCK_SIZE;
+    }
+    memcpy(s->tail, p, len);
+    s->tailLen = len;
+}
+
+uint64_t opScannerFinish(OpScanner *s) {
+    if (s->tailLen > 0) scanBlock(s, s->tail, s->tailLen, -1);
+    s->tailLen = 0;
+    if (s->dict) dictBreak(s);
+    return s->count;
+}
+
+/* Counts operators in buf[0..len) with the same rules as countOperators. */
+uint64_t countOperatorsBuffer(const char *buf, size_t len) {
+    OpScanner s;
+    opScannerInit(&s);
+    opScannerFeed(&s, buf, len);
+    uint64_t count = opScannerFinish(&s);
+    opScannerRelease(&s);
+    return count;
+}
+
+void validatorInit(Validator *v, RangeFn onRange, void *ctx) {
+    memset(v, 0, sizeof(*v));
+    v->onRange = onRange;
+    v->ctx = ctx;
+    v->vectorReady = true;
+    if (!validAscii['a']) buildValidTables();
+    if (!activeKernel) selectKernel(NULL);
+}
+
+void validatorFeed(Validator *v, const char *buf, size_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+
+    if (v->tailLen > 0) {
+        size_t take = BLOCK_SIZE - v->tailLen;
+        if (take > len) take = len;
+        memcpy(v->tail + v->tailLen, p, take);
+        v->tailLen += take;
+        p += take;
+        len -= take;
+        if (v->tailLen < BLOCK_SIZE) return;
+        activeKernel->validateRange(v, v->tail, 1);
+        v->tailLen = 0;
+    }
+    size_t nblocks = len / BLOCK_SIZE;
+    activeKernel->validateRange(v, p, nblocks);
+    p += nblocks * BLOCK_SIZE;
+    len -= nblocks * BLOCK_SIZE;
+    memcpy(v->tail, p, len);
+    v->tailLen = len;
+}
+
+/* Returns true when the whole input was valid. */
+bool validatorFinish(Validator *v) {
+    validateBytes(v, v->tail, v->tailLen);
+    v->tailLen = 0;
+    if (v->need > 0) {
+        v->utf8Errors++;
+        v->need = 0;
+        markInvalid(v, v->seqStart, v->offset);
+    }
+    flushRange(v);
+    v->rangeStart = v->rangeEnd = v->offset;
+    return v->invalidBytes == 0;
+}
+
+/*
+ * Hands the contents of path ("-" for stdin) to fn piece by piece.
+ * Regular files are mapped MAP_WINDOW bytes at a time; pipes, terminals
+ * and systems without mmap go through READ_BUFFER-sized reads. Memory
+ * use is bounded by one window or one buffer whatever the input size.
+ * Returns the number of bytes read, or -1 if the file cannot be read.
+ */
+long long forEachChunk(const char *path, ChunkFn fn, void *ctx) {
+    bool useStdin = strcmp(path, "-") == 0;
+    int fd = useStdin ? 0 : open(path, O_RDONLY);
+    long long total = 0;
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open file %s\n", path);
+        if (fd > 0) close(fd);
+        return -1;
+    }
+
+#ifndef _WIN32
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        for (off_t offset = 0; offset < st.st_size; offset += MAP_WINDOW) {
+            size_t len = (size_t)(st.st_size - offset);
+            if (len > MAP_WINDOW) len = MAP_WINDOW;
+
+            void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, offset);
+            if (map == MAP_FAILED) {
+                fprintf(stderr, "Error: Cannot map file %s\n", path);
+                if (!useStdin) close(fd);
+                return -1;
+            }
+            madvise(map, len, MADV_SEQUENTIAL);
+            fn(ctx, (const char *)map, len);
+            munmap(map, len);
+            total += (long long)len;
+        }
+        if (!useStdin) close(fd);
+        return total;
+    }
+#endif
+
+    char *buffer = malloc(READ_BUFFER);
+    if (!buffer) {
+        fprintf(stderr, "Error: Out of memory\n");
+        if (!useStdin) close(fd);
+        return -1;
+    }
+    for (;;) {
+        long n = (long)read(fd, buffer, READ_BUFFER);
+        if (n < 0) {
+            fprintf(stderr, "Error: Cannot read file %s\n", path);
+            total = -1;
+            break;
+        }
+        if (n == 0) break;
+        fn(ctx, buffer, (size_t)n);
+        total += n;
+    }
+    free(buffer);
+    if (!useStdin) close(fd);
+    return total;
+}
+
+static void feedScanner(void *ctx, const char *buf, size_t len) {
+    opScannerFeed((OpScanner *)ctx, buf, len);
+}
+
+static void printOperatorSummary(const char *path, long long bytes, const OpScanner *s) {
+    printf("File: %s\n", strcmp(path, "-") == 0 ? "(stdin)" : path);
+    printf("Bytes scanned: %lld\n", bytes);
+    printf("Total operators count: %llu\n", (unsigned long long)s->count);
+    if (!s->histogram) return;
+
+    printf("Operator histogram:\n");
+    for (int k = 0; k < kindCount(); k++) {
+        if (s->kinds[k] == 0) continue;
+        printf("  %-3s %llu\n", kindName(k), (unsigned long long)s->kinds[k]);
+    }
+}
+
+/* Output buffer for reports; one fwrite per 64 KiB instead of a printf per row. */
+typedef struct {
+    FILE *out;
+    size_t len;
+    char buf[1 << 16];
+} ReportWriter;
+
+static void writerFlush(ReportWriter *w) {
+    fwrite(w->buf, 1, w->len, w->out);
+    w->len = 0;
+}
+
+static void writeBytes(ReportWriter *w, const char *text, size_t len) {
+    if (w->len + len > sizeof(w->buf)) writerFlush(w);
+    if (len > sizeof(w->buf)) {
+        fwrite(text, 1, len, w->out);
+        return;
+    }
+    memcpy(w->buf + w->len, text, len);
+    w->len += len;
+}
+
+static void writeText(ReportWriter *w, const char *text) {
+    writeBytes(w, text, strlen(text));
+}
+
+static void writeNumber(ReportWriter *w, uint64_t value) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    writeBytes(w, digits + sizeof(digits) - n, (size_t)n);
+}
+
+/* Writes text as a JSON string, or as a CSV field when csv is set. */
+static void writeQuoted(ReportWriter *w, const char *text, bool csv) {
+    writeBytes(w, "\"", 1);
+    for (const char *c = text; *c; c++) {
+        if (*c == '"') {
+            writeText(w, csv ? "\"\"" : "\\\"");
+        } else if (*c == '\\' && !csv) {
+            writeText(w, "\\\\");
+        } else {
+            writeBytes(w, c, 1);
+        }
+    }
+    writeBytes(w, "\"", 1);
+}
+
+/* Number of lines to report; an input without a final newline has one more. */
+static size_t reportedLines(const OpScanner *s) {
+    return s->lineCount + (s->lastByte >= 0 && s->lastByte != '\n' ? 1 : 0);
+}
+
+static uint32_t lineOpsAt(const OpScanner *s, size_t line) {
+    return line < s->lineCount ? s->lineOps[line] : s->openLineOps;
+}
+
+/*
+ * CSV report: one table with a section column, so that both the operator
+ * histogram and the per-line counts fit in a single valid CSV file.
+ */
+static void writeCsvReport(ReportWriter *w, const OpScanner *s) {
+    writeText(w, "section,key,count\ntotal,,");
+    writeNumber(w, s->count);
+    writeText(w, "\n");
+    for (int k = 0; k < kindCount(); k++) {
+        writeText(w, "operator,");
+        writeQuoted(w, kindName(k), true);
+        writeText(w, ",");
+        writeNumber(w, s->kinds[k]);
+        writeText(w, "\n");
+    }
+    size_t lines = reportedLines(s);
+    for (size_t line = 0; line < lines; line++) {
+        writeText(w, "line,");
+        writeNumber(w, line + 1);
+        writeText(w, ",");
+        writeNumber(w, lineOpsAt(s, line));
+        writeText(w, "\n");
+    }
+}
+
+/* JSON report: "lines" holds the operator count of line i + 1 at index i. */
+static void writeJsonReport(ReportWriter *w, const char *path, long long bytes, const OpScanner *s) {
+    writeText(w, "{\n  \"file\": ");
+    writeQuoted(w, strcmp(path, "-") == 0 ? "(stdin)" : path, false);
+    writeText(w, ",\n  \"bytes\": ");
+    writeNumber(w, (uint64_t)bytes);
+    writeText(w, ",\n  \"total\": ");
+    writeNumber(w, s->count);
+    writeText(w, ",\n  \"operators\": {");
+    for (int k = 0; k < kindCount(); k++) {
+        writeText(w, k == 0 ? "\n    " : ",\n    ");
+        writeQuoted(w, kindName(k), false);
+        writeText(w, ": ");
+        writeNumber(w, s->kinds[k]);
+    }
+    writeText(w, "\n  },\n  \"lines\": [");
+    size_t lines = reportedLines(s);
+    for (size_t line = 0; line < lines; line++) {
+        if (line > 0) writeBytes(w, ",", 1);
+        if (line % 20 == 0) writeText(w, "\n    ");
+        writeNumber(w, lineOpsAt(s, line));
+    }
+    writeText(w, "\n  ]\n}\n");
+}
+
+/* Prints the -r report, or the plain summary without -r. */
+static void reportOperators(const char *path, long long bytes, const OpScanner *s) {
+    if (!reportFormat) {
+        printOperatorSummary(path, bytes, s);
+        return;
+    }
+
+    static ReportWriter writer;
+    writer.out = stdout;
+    writer.len = 0;
+    if (strcmp(reportFormat, "csv") == 0) {
+        writeCsvReport(&writer, s);
+    } else {
+        writeJsonReport(&writer, path, bytes, s);
+    }
+    writerFlush(&writer);
+    fflush(stdout);
+}
+
+/* TASK 4 over a whole file: prints the operator total of path. */
+int countOperatorsInFile(const char *path) {
+    OpScanner s;
+    opScannerInit(&s);
+    s.histogram = true;
+
+    long long bytes = forEachChunk(path, feedScanner, &s);
+    if (bytes < 0) {
+        opScannerRelease(&s);
+        return 1;
+    }
+
+    opScannerFinish(&s);
+    reportOperators(path, bytes, &s);
+    opScannerRelease(&s);
+    return 0;
+}
+
+/* One slice of the input handled by a worker thread. */
+typedef struct {
+    const uint8_t *base;
+    size_t len;            /* length of the whole input */
+    size_t begin, end;
+    OpScanner scanner;
+} ChunkJob;
+
+static int nextByte(const uint8_t *base, size_t len, size_t pos) {
+    return pos < len ? base[pos] : -1;
+}
+
+static void *countChunk(void *arg) {
+    ChunkJob *job = (ChunkJob *)arg;
+    scanSpan(&job->scanner, job->base + job->begin, job->end - job->begin,
+             nextByte(job->base, job->len, job->end));
+    return NULL;
+}
+
+static bool sameScanState(const OpScanner *a, const OpScanner *b) {
+    return a->pairCarry == b->pairCarry && a->lexState == b->lexState &&
+           a->escapeCarry == b->escapeCarry && a->lexSkip == b->lexSkip &&
+           a->dfaState == b->dfaState && a->lastKind == b->lastKind &&
+           a->lastLen == b->lastLen && a->pendingLen == b->pendingLen &&
+           memcmp(a->pending, b->pending, a->pendingLen) == 0;
+}
+
+/* Copies the position-dependent part of a scanner, not its counts. */
+static void copyScanState(OpScanner *to, const OpScanner *from) {
+    to->pairCarry = from->pairCarry;
+    to->lexState = from->lexState;
+    to->escapeCarry = from->escapeCarry;
+    to->lexSkip = from->lexSkip;
+    to->dfaState = from->dfaState;
+    to->lastKind = from->lastKind;
+    to->lastLen = from->lastLen;
+    to->pendingLen = from->pendingLen;
+    memcpy(to->pending, from->pending, sizeof(to->pending));
+}
+
+/*
+ * into += plus - minus, for the total, every kind and every line. plus
+ * and minus scanned the same prefix of into's input, so they have the
+ * same lines and line i of theirs is line i of into.
+ */
+static void addCountDelta(OpScanner *into, const OpScanner *plus, const OpScanner *minus) {
+    into->count += plus->count - minus->count;
+    for (int k = 0; k < MAX_OP_KINDS; k++) {
+        into->kinds[k] += plus->kinds[k] - minus->kinds[k];
+    }
+    for (size_t line = 0; line <= plus->lineCount && into->lines; line++) {
+        uint32_t *slot = line < into->lineCount ? &into->lineOps[line] : &into->openLineOps;
+        *slot += lineOpsAt(plus, line) - lineOpsAt(minus, line);
+    }
+}
+
+/* Appends the lines of a later chunk; its first line continues our open one. */
+static void appendLines(OpScanner *into, const OpScanner *chunk) {
+    for (size_t line = 0; line < chunk->lineCount; line++) {
+        into->openLineOps += chunk->lineOps[line];
+        closeLine(into);
+    }
+    into->openLineOps += chunk->openLineOps;
+}
+
+/*
+ * Every chunk is scanned as if nothing spilled into it from the previous
+ * one. When the previous chunk really ends on the first byte of a
+ * two-character operator, or inside a comment or literal, the start of
+ * this chunk is rescanned twice, from the assumed and from the actual
+ * state, until both scans reach the same state; from there on they
+ * agree, so their difference is the fix. That normally takes a single
+ * RECONCILE_SPAN.
+ */
+static void reconcileChunk(ChunkJob *job, const OpScanner *actualStart) {
+    OpScanner assumed, actual;
+
+    opScannerInit(&assumed);
+    assumed.histogram = job->scanner.histogram;
+    actual = assumed;
+    copyScanState(&actual, actualStart);
+    if (sameScanState(&assumed, &actual)) return;
+
+    size_t pos = job->begin;
+    bool converged = false;
+    while (pos < job->end && !converged) {
+        size_t stop = job->end - pos > RECONCILE_SPAN ? pos + RECONCILE_SPAN : job->end;
+        int next = nextByte(job->base, job->len, stop);
+        scanSpan(&assumed, job->base + pos, stop - pos, next);
+        scanSpan(&actual, job->base + pos, stop - pos, next);
+        converged = sameScanState(&assumed, &actual);
+        pos = stop;
+    }
+
+    addCountDelta(&job->scanner, &actual, &assumed);
+    if (!converged) copyScanState(&job->scanner, &actual);
+    opScannerRelease(&assumed);
+    opScannerRelease(&actual);
+}
+
+/*
+ * Counts operators in base[0..len) on up to `threads` threads and merges
+ * the per-thread histograms into result. Chunks are whole blocks long,
+ * and each one reads the first byte of the next as its lookahead.
+ */
+static bool countOperatorsParallel(const uint8_t *base, size_t len, int threads, OpScanner *result) {
+    ChunkJob jobs[MAX_THREADS];
+    pthread_t tids[MAX_THREADS];
+    size_t blocks = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if ((size_t)threads > blocks) threads = blocks > 0 ? (int)blocks : 1;
+
+    for (int t = 0; t < threads; t++) {
+        ChunkJob *job = &jobs[t];
+        job->base = base;
+        job->len = len;
+        job->begin = blocks * (size_t)t / (size_t)threads * BLOCK_SIZE;
+        job->end = blocks * (size_t)(t + 1) / (size_t)threads * BLOCK_SIZE;
+        if (job->end > len) job->end = len;
+        opScannerInit(&job->scanner);
+        job->scanner.histogram = result->histogram;
+        job->scanner.lines = result->lines;
+    }
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&tids[t], NULL, countChunk, &jobs[t]) != 0) {
+            fprintf(stderr, "Error: Cannot start worker thread\n");
+            for (int u = 1; u < t; u++) pthread_join(tids[u], NULL);
+            for (int u = 0; u < threads; u++) opScannerRelease(&jobs[u].scanner);
+            return false;
+        }
+    }
+    countChunk(&jobs[0]);
+    for (int t = 1; t < threads; t++) pthread_join(tids[t], NULL);
+
+    for (int t = 0; t < threads; t++) {
+        if (t > 0) reconcileChunk(&jobs[t], &jobs[t - 1].scanner);
+        /* a dictionary operator can still be open at the end of the input */
+        if (t == threads - 1 && jobs[t].scanner.dict) dictBreak(&jobs[t].scanner);
+        result->count += jobs[t].scanner.count;
+        for (int k = 0; k < MAX_OP_KINDS; k++) result->kinds[k] += jobs[t].scanner.kinds[k];
+        if (result->lines) appendLines(result, &jobs[t].scanner);
+        opScannerRelease(&jobs[t].scanner);
+    }
+    result->lastByte = len > 0 ? base[len - 1] : -1;
+    return true;
+}
+
+/* Maps the whole of path read-only; returns NULL if it is not a mappable regular file. */
+static const uint8_t *mapWholeFile(const char *path, size_t *len) {
+#ifdef _WIN32
+    (void)path;
+    (void)len;
+    return NULL;
+#else
+    struct stat st;
+    int fd = strcmp(path, "-") == 0 ? -1 : open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    madvise(map, (size_t)st.st_size, MADV_WILLNEED);
+    *len = (size_t)st.st_size;
+    return (const uint8_t *)map;
+#endif
+}
+
+static void unmapWholeFile(const uint8_t *base, size_t len) {
+#ifndef _WIN32
+    munmap((void *)base, len);
+#else
+    (void)base;
+    (void)len;
+#endif
+}
+
+static int onlineCpus(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) return n > MAX_THREADS ? MAX_THREADS : (int)n;
+#endif
+    return 1;
+}
+
+/* TASK 4 over a whole file on several threads. */
+int countOperatorsInFileParallel(const char *path, int threads) {
+    size_t len = 0;
+    const uint8_t *base = mapWholeFile(path, &len);
+    if (!base) {
+        fprintf(stderr, "Note: %s is not a mappable regular file, counting on one thread\n", path);
+        return countOperatorsInFile(path);
+    }
+
+    OpScanner s;
+    opScannerInit(&s);
+    s.histogram = true;
+    bool ok = countOperatorsParallel(base, len, threads, &s);
+    unmapWholeFile(base, len);
+    if (ok) reportOperators(path, (long long)len, &s);
+    opScannerRelease(&s);
+    return ok ? 0 : 1;
+}
+
+static double nowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/*
+ * Throughput of the parallel counter on path for 1, 2, 4, ... threads up
+ * to maxThreads. The input is counted once untimed so the page cache is
+ * warm, then each thread count keeps the best of `runs` timed passes.
+ */
+int benchmarkThreads(const char *path, int maxThreads, int runs) {
+    size_t len = 0;
+    const uint8_t *base = mapWholeFile(path, &len);
+    if (!base) {
+        fprintf(stderr, "Error: Benchmark needs a non-empty regular file\n");
+        return 1;
+    }
+
+    OpScanner warm;
+    opScannerInit(&warm);
+    countOperatorsParallel(base, len, maxThreads, &warm);
+    opScannerRelease(&warm);
+
+    printf("Kernel: %s, input: %s (%.1f MB), best of %d runs\n",
+           activeKernel->name, path, (double)len / 1e6, runs);
+    printf("%-8s | %-10s | %-10s | %-8s\n", "Threads", "MB/s", "Speedup", "Count");
+    printf("---------+------------+------------+---------\n");
+
+    int counts[32];
+    int n = 0;
+    for (int t = 1; t < maxThreads; t *= 2) counts[n++] = t;
+    counts[n++] = maxThreads;
+
+    double baseRate = 0;
+    for (int i = 0; i < n; i++) {
+        double best = 0;
+        OpScanner s;
+        for (int r = 0; r < runs; r++) {
+            opScannerInit(&s);
+            double start = nowSeconds();
+            countOperatorsParallel(base, len, counts[i], &s);
+            double elapsed = nowSeconds() - start;
+            opScannerRelease(&s);
+            if (best == 0 || elapsed < best) best = elapsed;
+        }
+        double rate = (double)len / 1e6 / best;
+        if (i == 0) baseRate = rate;
+        printf("%-8d | %-10.1f | %-10.2f | %llu%s\n", counts[i], rate, rate / baseRate,
+               (unsigned long long)s.count, s.count == warm.count ? "" : " MISMATCH");
+    }
+
+    unmapWholeFile(base, len);
+    return 0;
+}
+
+static void printOperator(void *ctx, int kind) {
+    (void)ctx;
+    printf("%s ", kindName(kind));
+}
+
+/*
+ * Lists and counts the operators of input in one scan, so both follow
+ * the -c and -o settings. The list needs each operator in order, which
+ * only the dictionary scan produces, so the built-in set is run as one.
+ */
 int countOperators(char *input) {
     int count = 0;
     int len = strlen(input);
+    OpScanner s;
     
     printf("\n TASK 4\n");
     printf("Input string: %s\n", input);
     printf("Operators found: ");
     
-    for (int i = 0; i < len; i++) {
-        if (isMultiCharOperator(input, i)) {
-            printf("%.2s ", &input[i]);
-            count++;
-            i++; 
-        }
-        else if (isArithmeticOperator(input[i])) {
-            printf("%c ", input[i]);
-            count++;
-        }
-    }
-    
+    opScannerInit(&s);
+    if (!s.dict) s.dict = builtinAsDictionary();
+    s.onOperator = printOperator;
+    opScannerFeed(&s, input, (size_t)len);
+    count = (int)opScannerFinish(&s);
+    opScannerRelease(&s);
     printf("\nTotal operators count: %d\n", count);
     return count;
 }
 
+static void markRangeInvalid(void *ctx, uint64_t start, uint64_t end) {
+    bool *invalid = (bool *)ctx;
+    for (uint64_t i = start; i < end; i++) invalid[i] = true;
+}
+
 bool validateInputString(char *input) {
     int len = strlen(input);
-    bool isValid = true;
-    
+    bool *invalid = calloc((size_t)len + 1, sizeof(bool));
+    Validator v;
+
+    if (!invalid) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return false;
+    }
+    validatorInit(&v, markRangeInvalid, invalid);
+    validatorFeed(&v, input, (size_t)len);
+    bool isValid = validatorFinish(&v);
+
     printf("\n TASK 5\n");
     printf("Input string: \"%s\"\n", input);
     printf("Checking each character:\n");
     
     for (int i = 0; i < len; i++) {
-        char ch = input[i];
+        unsigned char ch = (unsigned char)input[i];
         
-        if (isalnum(ch)) {
-            printf("'%c' - Valid (alphanumeric)\n", ch);
-        }
-        else if (isspace(ch)) {
-            if (ch == ' ') {
-                printf("' ' - Valid (whitespace)\n");
-            } else if (ch == '\t') {
-                printf("'\\t' - Valid (tab)\n");
-            } else if (ch == '\n') {
-                printf("'\\n' - Valid (newline)\n");
+        if (invalid[i]) {
+            if (ch < 0x80 && isprint(ch)) {
+                printf("'%c' - INVALID (not alphanumeric, whitespace, or arithmetic operator)\n", ch);
             } else {
-                printf("'%c' - Valid (whitespace)\n", ch);
+                printf("'\\x%02X' - INVALID (not alphanumeric, whitespace, arithmetic operator or UTF-8)\n", ch);
             }
         }
-        else if (isArithmeticOperator(ch)) {
-            printf("'%c' - Valid (arithmetic operator)\n", ch);
+        else if (ch >= 0x80) {
+            int n = 1;
+            while (i + n < len && (input[i + n] & 0xC0) == 0x80 && !invalid[i + n]) n++;
+            printf("'%.*s' - Valid (UTF-8 character)\n", n, &input[i]);
+            i += n - 1;
+        }
+        else if (isalnum(ch)) {
+            printf("'%c' - Valid (alphanumeric)\n", ch);
+        }
+        else if (ch == ' ') {
+            printf("' ' - Valid (whitespace)\n");
+        }
+        else if (ch == '\t') {
+            printf("'\\t' - Valid (tab)\n");
+        }
+        else if (ch == '\n') {
+            printf("'\\n' - Valid (newline)\n");
+        }
+        else if (isspace(ch)) {
+            printf("'\\x%02X' - Valid (whitespace)\n", ch);
         }
         else {
-            printf("'%c' - INVALID (not alphanumeric, whitespace, or arithmetic operator)\n", ch);
-            isValid = false;
+            printf("'%c' - Valid (arithmetic operator)\n", ch);
         }
     }
     
+    if (!isValid) {
+        printf("Invalid byte ranges:");
+        for (int i = 0; i < len; i++) {
+            if (!invalid[i] || (i > 0 && invalid[i - 1])) continue;
+            int end = i;
+            while (end < len && invalid[end]) end++;
+            printf(" [%d, %d)", i, end);
+        }
+        printf("\n");
+    }
     printf("\nValidation result: %s\n", isValid ? "VALID" : "INVALID");
+    free(invalid);
     return isValid;
 }
 
-int main() {
+static void writeRange(void *ctx, uint64_t start, uint64_t end) {
+    ReportWriter *w = (ReportWriter *)ctx;
+    writeText(w, "  [");
+    writeNumber(w, start);
+    writeText(w, ", ");
+    writeNumber(w, end);
+    writeText(w, ")\n");
+}
+
+static void feedValidator(void *ctx, const char *buf, size_t len) {
+    validatorFeed((Validator *)ctx, buf, len);
+}
+
+/*
+ * TASK 5 over a whole file: prints the invalid byte ranges of path as
+ * they are found, then a summary. Returns 1 if any byte is invalid.
+ */
+int validateFile(const char *path) {
+    static ReportWriter writer;
+    Validator v;
+
+    writer.out = stdout;
+    writer.len = 0;
+    validatorInit(&v, writeRange, &writer);
+    printf("File: %s\n", strcmp(path, "-") == 0 ? "(stdin)" : path);
+    printf("Invalid byte ranges:\n");
+    fflush(stdout);
+
+    long long bytes = forEachChunk(path, feedValidator, &v);
+    if (bytes < 0) return 1;
+    bool valid = validatorFinish(&v);
+    if (valid) writeText(&writer, "  none\n");
+    writerFlush(&writer);
+
+    printf("Bytes validated: %lld\n", bytes);
+    printf("Invalid bytes: %llu in %llu ranges\n",
+           (unsigned long long)v.invalidBytes, (unsigned long long)v.rangeCount);
+    printf("Validation result: %s\n", valid ? "VALID" : "INVALID");
+    return valid ? 0 : 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-k avx2|sse2|scalar] [-j THREADS] [-c] [-o OPFILE] [-r csv|json] [-b] [-v] [-f FILE]\n", prog);
+    fprintf(stderr, "  -f FILE     count operators in FILE ('-' reads stdin)\n");
+    fprintf(stderr, "  -c          skip comments, string and character literals\n");
+    fprintf(stderr, "  -o OPFILE   count the operators listed in OPFILE instead of the built-in set\n");
+    fprintf(stderr, "  -r FORMAT   write per-operator and per-line counts as csv or json\n");
+    fprintf(stderr, "  -v          validate FILE and print the ranges of invalid bytes\n");
+    fprintf(stderr, "  -k NAME     force a scanner kernel\n");
+    fprintf(stderr, "  -j THREADS  count on THREADS threads (0 = one per CPU)\n");
+    fprintf(stderr, "  -b          benchmark FILE with 1, 2, 4, ... THREADS threads\n");
+    fprintf(stderr, "Without -f the program runs interactively.\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *file = NULL;
+    int threads = 1;
+    bool bench = false;
+    bool validate = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            file = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads <= 0) threads = onlineCpus();
+            if (threads > MAX_THREADS) threads = MAX_THREADS;
+        } else if (strcmp(argv[i], "-b") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            validate = true;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            skipCommentsAndLiterals = true;
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            reportFormat = argv[++i];
+            if (strcmp(reportFormat, "csv") != 0 && strcmp(reportFormat, "json") != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            if (!loadOperatorDictionary(argv[++i], &loadedDictionary)) return 1;
+            activeDictionary = &loadedDictionary;
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            if (!selectKernel(argv[++i])) {
+                fprintf(stderr, "Error: Kernel '%s' is not available on this CPU\n", argv[i]);
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (validate) {
+        if (!file) {
+            usage(argv[0]);
+            return 1;
+        }
+        return validateFile(file);
+    }
+    if (bench) {
+        if (!file) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (!activeKernel) selectKernel(NULL);
+        return benchmarkThreads(file, threads > 1 ? threads : onlineCpus(), 3);
+    }
+    if (file && threads > 1) return countOperatorsInFileParallel(file, threads);
+    if (file) return countOperatorsInFile(file);
+
     char codeSnippet[256];
     char validateStr[256];
     printf("Enter code snippet to count operators: ");
@@ -103,4 +2008,4 @@ int main() {
     countOperators(codeSnippet);
     validateInputString(validateStr);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,329 @@
+/*
+ * Benchmark of the two operator scanners of practical 1: the hand-written
+ * one in practical01.c and the flex one in practical01.l.
+ *
+ *   gcc -O2 -o practical01 practical01.c -lpthread
+ *   flex -o practical01_lexer.c practical01.l && gcc -O2 -o practical01_lexer practical01_lexer.c -lpthread
+ *   gcc -O2 -o practical01_bench practical01_bench.c
+ *   ./practical01_bench [-s MB,MB,...] [-r RUNS] [-w WARMUP] [-d DIR]
+ *
+ * For every size and corpus kind a synthetic file is written to DIR, each
+ * scanner is run WARMUP times untimed and RUNS times timed on it, and the
+ * file is deleted again. The hand-written scanner reads the file with
+ * -f; the flex scanner reads it on stdin in its counter-only -q mode.
+ * Output goes to /dev/null.
+ * ns/token divides by the number of tokens practical01.l's rules find in
+ * the corpus (whitespace excluded), which the generator counts itself, so
+ * both scanners are charged per token of the same input.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define MAX_SIZES 16
+#define MAX_RUNS 100
+#define GEN_BUFFER (1u << 20)
+#define MAX_ARGS 8
+
+typedef enum { CORPUS_OPERATORS, CORPUS_IDENTIFIERS, CORPUS_WHITESPACE, CORPUS_KIND_COUNT } CorpusKind;
+
+static const char *corpusNames[CORPUS_KIND_COUNT] = { "operator-dense", "identifier-dense", "whitespace-heavy" };
+
+/* One scanner under test; "{}" in argv is replaced by the corpus path. */
+typedef struct {
+    const char *name;
+    const char *argv[MAX_ARGS];
+    bool readsStdin;
+} Scanner;
+
+static Scanner scanners[] = {
+    { "practical01.c", { "./practical01", "-f", "{}", NULL }, false },
+    { "practical01.l", { "./practical01_lexer", "-q", NULL }, true },
+};
+
+#define SCANNER_COUNT ((int)(sizeof(scanners) / sizeof(scanners[0])))
+
+static const char *singleOps = "+-*/%=<>!&|^~";
+static const char *multiOps[] = { "++", "--", "==", "!=", "<=", ">=", "&&", "||", ">>", "<<" };
+
+static uint64_t rngState = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t nextRandom(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return (uint32_t)(rngState >> 11);
+}
+
+static bool isLetter(int c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool isDigit(int c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool isMultiOp(const char *p, size_t left) {
+    if (left < 2) return false;
+    for (size_t i = 0; i < sizeof(multiOps) / sizeof(multiOps[0]); i++) {
+        if (p[0] == multiOps[i][0] && p[1] == multiOps[i][1]) return true;
+    }
+    return false;
+}
+
+/* Tokens practical01.l's rules match in buf, whitespace not counted. */
+static uint64_t countTokens(const char *buf, size_t len) {
+    uint64_t tokens = 0;
+    size_t i = 0;
+
+    while (i < len) {
+        char c = buf[i];
+        if (c == ' ' || c == '\t' || c == '\n') {
+            i++;
+            continue;
+        }
+        tokens++;
+        if (isLetter(c)) {
+            while (i < len && (isLetter(buf[i]) || isDigit(buf[i]))) i++;
+        } else if (isDigit(c)) {
+            while (i < len && isDigit(buf[i])) i++;
+        } else {
+            i += isMultiOp(buf + i, len - i) ? 2 : 1;
+        }
+    }
+    return tokens;
+}
+
+static size_t putIdentifier(char *p, int minLen, int maxLen) {
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    int len = minLen + (int)(nextRandom() % (uint32_t)(maxLen - minLen + 1));
+    p[0] = chars[nextRandom() % 52];
+    for (int i = 1; i < len; i++) p[i] = chars[nextRandom() % 62];
+    return (size_t)len;
+}
+
+static size_t putOperator(char *p) {
+    if (nextRandom() % 3 == 0) {
+        const char *op = multiOps[nextRandom() % (sizeof(multiOps) / sizeof(multiOps[0]))];
+        p[0] = op[0];
+        p[1] = op[1];
+        return 2;
+    }
+    p[0] = singleOps[nextRandom() % 13];
+    return 1;
+}
+
+static size_t putWhitespace(char *p, int minLen, int maxLen) {
+    static const char chars[] = "    \t\n";
+    int len = minLen + (int)(nextRandom() % (uint32_t)(maxLen - minLen + 1));
+    for (int i = 0; i < len; i++) p[i] = chars[nextRandom() % 6];
+    return (size_t)len;
+}
+
+/* Fills one line of about 80 bytes; buf must have room for 200. */
+static size_t generateLine(CorpusKind kind, char *buf) {
+    size_t n = 0;
+
+    while (n < 80) {
+        switch (kind) {
+        case CORPUS_OPERATORS:
+            /* four operators to every one-letter operand */
+            if (nextRandom() % 5 == 0) {
+                n += putIdentifier(buf + n, 1, 1);
+            } else {
+                n += putOperator(buf + n);
+            }
+            break;
+        case CORPUS_IDENTIFIERS:
+            n += putIdentifier(buf + n, 4, 16);
+            buf[n++] = ' ';
+            if (nextRandom() % 8 == 0) {
+                n += putOperator(buf + n);
+                buf[n++] = ' ';
+            }
+            break;
+        default:
+            n += putIdentifier(buf + n, 2, 8);
+            n += putWhitespace(buf + n, 8, 48);
+            if (nextRandom() % 4 == 0) {
+                n += putOperator(buf + n);
+                n += putWhitespace(buf + n, 8, 48);
+            }
+            break;
+        }
+    }
+    buf[n++] = '\n';
+    return n;
+}
+
+/* Writes size bytes of the given kind to path; returns the token count or -1. */
+static long long generateCorpus(const char *path, CorpusKind kind, size_t size) {
+    FILE *out = fopen(path, "wb");
+    char *buf = malloc(GEN_BUFFER + 256);
+    uint64_t tokens = 0;
+    size_t written = 0;
+
+    if (!out || !buf) {
+        fprintf(stderr, "Error: Cannot create %s\n", path);
+        if (out) fclose(out);
+        free(buf);
+        return -1;
+    }
+    while (written < size) {
+        size_t len = 0;
+        size_t want = size - written < GEN_BUFFER ? size - written : GEN_BUFFER;
+        while (len < want) len += generateLine(kind, buf + len);
+        if (len > want) {
+            /* end the last piece on a line break so no token is cut */
+            len = want;
+            buf[len - 1] = '\n';
+        }
+        tokens += countTokens(buf, len);
+        if (fwrite(buf, 1, len, out) != len) {
+            fprintf(stderr, "Error: Cannot write %s\n", path);
+            fclose(out);
+            free(buf);
+            return -1;
+        }
+        written += len;
+    }
+    free(buf);
+    if (fclose(out) != 0) return -1;
+    return (long long)tokens;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Runs one scanner on path; stores wall seconds and peak RSS in KiB. */
+static bool runScanner(const Scanner *sc, const char *path, double *seconds, long *peakKb) {
+    const char *argv[MAX_ARGS];
+    int i;
+
+    for (i = 0; sc->argv[i]; i++) {
+        argv[i] = strcmp(sc->argv[i], "{}") == 0 ? path : sc->argv[i];
+    }
+    argv[i] = NULL;
+
+    double start = now();
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0) dup2(devNull, 1);
+        if (sc->readsStdin) {
+            int in = open(path, O_RDONLY);
+            if (in < 0) _exit(127);
+            dup2(in, 0);
+        }
+        execv(argv[0], (char *const *)argv);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) return false;
+    *seconds = now() - start;
+    *peakKb = usage.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-s MB,MB,...] [-r RUNS] [-w WARMUP] [-d DIR]\n", prog);
+    fprintf(stderr, "  -s SIZES   corpus sizes in MB (default 1,10,100,1000)\n");
+    fprintf(stderr, "  -r RUNS    timed runs per scanner and corpus (default 5)\n");
+    fprintf(stderr, "  -w WARMUP  untimed runs before them (default 1)\n");
+    fprintf(stderr, "  -d DIR     where the corpora are written (default .)\n");
+}
+
+int main(int argc, char *argv[]) {
+    size_t sizes[MAX_SIZES] = { 1, 10, 100, 1000 };
+    int sizeCount = 4;
+    int runs = 5, warmup = 1;
+    const char *dir = ".";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            sizeCount = 0;
+            for (char *p = strtok(argv[++i], ","); p && sizeCount < MAX_SIZES; p = strtok(NULL, ",")) {
+                sizes[sizeCount++] = (size_t)strtoul(p, NULL, 10);
+            }
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (runs < 1 || runs > MAX_RUNS || warmup < 0 || sizeCount == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    bool available[SCANNER_COUNT];
+    for (int s = 0; s < SCANNER_COUNT; s++) {
+        available[s] = access(scanners[s].argv[0], X_OK) == 0;
+        if (!available[s]) {
+            fprintf(stderr, "Skipping %s: %s is not built\n", scanners[s].name, scanners[s].argv[0]);
+        }
+    }
+
+    printf("%-16s %-8s %-14s %10s %10s %10s %12s\n",
+           "corpus", "MB", "scanner", "best MB/s", "med MB/s", "ns/token", "peak RSS KiB");
+    for (int z = 0; z < sizeCount; z++) {
+        for (int k = 0; k < CORPUS_KIND_COUNT; k++) {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/practical01_bench_%s_%zuMB.txt", dir, corpusNames[k], sizes[z]);
+            long long tokens = generateCorpus(path, (CorpusKind)k, sizes[z] << 20);
+            if (tokens < 0) return 1;
+            double mb = (double)(sizes[z] << 20) / (1 << 20);
+
+            for (int s = 0; s < SCANNER_COUNT; s++) {
+                if (!available[s]) continue;
+                double times[MAX_RUNS], seconds = 0;
+                long peakKb = 0, kb = 0;
+                bool ok = true;
+
+                for (int r = 0; r < warmup + runs && ok; r++) {
+                    ok = runScanner(&scanners[s], path, &seconds, &kb);
+                    if (r < warmup) continue;
+                    times[r - warmup] = seconds;
+                    if (kb > peakKb) peakKb = kb;
+                }
+                if (!ok) {
+                    printf("%-16s %-8zu %-14s failed\n", corpusNames[k], sizes[z], scanners[s].name);
+                    continue;
+                }
+                qsort(times, (size_t)runs, sizeof(double), compareDoubles);
+                double median = times[runs / 2];
+                printf("%-16s %-8zu %-14s %10.1f %10.1f %10.2f %12ld\n",
+                       corpusNames[k], sizes[z], scanners[s].name,
+                       mb / times[0], mb / median,
+                       tokens > 0 ? median * 1e9 / (double)tokens : 0.0, peakKb);
+                fflush(stdout);
+            }
+            remove(path);
+        }
+    }
+    return 0;
+}
@@ -1,26 +1,87 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 
-#define MAX_IDENTIFIERS 100
 #define MAX_LENGTH 50
 #define MAX_KEYWORDS 32
 
+/*
+ * Names, datatypes and scopes are interned: each distinct string is
+ * stored once in the pool and a symbol holds its 32-bit id, so two
+ * strings are equal exactly when their ids are. An id is the string's
+ * offset in the pool's text.
+ */
 typedef struct {
-    char name[MAX_LENGTH];
-    char datatype[MAX_LENGTH];
-    char scope[MAX_LENGTH];
-    int memory_usage;
+    uint32_t id;            // NO_STRING for an empty slot
+    uint32_t hash;
+} StringSlot;
+
+typedef struct {
+    char *chars;            // NUL-terminated strings back to back
+    size_t size;
+    size_t capacity;
+    uint32_t count;
+    StringSlot *slots;
+    uint32_t slot_count;    // a power of two
+} StringPool;
+
+#define NO_STRING UINT32_MAX
+
+typedef struct {
+    uint32_t name;
+    uint32_t datatype;
+    uint32_t scope;
     int line_number;
+    int shadowed;           // symbol of the same name this one hides, or -1
+    uint8_t memory_usage;
+    bool declared_extern : 1;   // only declared so far, by an extern declaration
+    bool defined : 1;           // a function whose body has been read
+    uint16_t depth;         // nesting depth of its scope, 0 for global
 } Symbol;
 
+/*
+ * Every declaration is kept in order in a growing array. An
+ * open-addressing hash table with linear probing maps each name to the
+ * innermost symbol of that name in the open scopes, and doubles once it
+ * is more than 70% full, so lookups stay O(1) on average however many
+ * symbols there are. A symbol that hides another links to it, and the
+ * undo log lists the symbols of the open scopes in declaration order:
+ * leaving a scope walks its part of the log and puts each hidden symbol
+ * back, so it costs time proportional to the symbols declared in it.
+ */
+typedef struct {
+    int index;          // into table, or -1 for an empty slot
+    uint32_t hash;
+} SymbolSlot;
+
 typedef struct {
-    Symbol table[MAX_IDENTIFIERS];
+    uint32_t name;      // interned scope name
+    int undo_start;     // first undo_log entry declared in this scope
+} Scope;
+
+typedef struct {
+    Symbol *table;
     int count;
+    int capacity;
+    SymbolSlot *slots;
+    int slot_count;     // a power of two
+    int visible;        // occupied slots
+    int *undo_log;
+    int undo_count;
+    int undo_capacity;
+    Scope *scopes;      // scopes[0] is global, scopes[depth] the innermost
+    int depth;
+    int scope_capacity;
+    unsigned long long lookups;
+    unsigned long long probes;  // slots examined by all lookups
 } SymbolTable;
 
+#define INITIAL_SLOTS 64
+#define MAX_LOAD_PERCENT 70
+
 static const char KEYWORDS[MAX_KEYWORDS][MAX_LENGTH] = {
     "auto", "break", "case", "char", "const", "continue", "default", "do",
     "double", "else", "enum", "extern", "float", "for", "goto", "if",
@@ -28,19 +89,104 @@ static const char KEYWORDS[MAX_KEYWORDS][MAX_LENGTH] = {
     "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while"
 };
 
+/*
+ * The keywords by perfect hash: (54 * first char + last char + length)
+ * mod 64 puts each in its own slot, so is_keyword makes one compare. The
+ * multiplier was found by trying 1..63 until no two keywords collided;
+ * adding a keyword needs a new search.
+ */
+#define KEYWORD_SLOTS 64
+
+static const struct {
+    const char *text;
+    int length;
+} keyword_slots[KEYWORD_SLOTS] = {
+    [0] = { "return", 6 }, [2] = { "extern", 6 }, [3] = { "double", 6 },
+    [4] = { "while", 5 }, [6] = { "register", 8 }, [9] = { "do", 2 },
+    [11] = { "case", 4 }, [12] = { "void", 4 }, [14] = { "if", 2 },
+    [15] = { "continue", 8 }, [17] = { "volatile", 8 }, [19] = { "default", 7 },
+    [24] = { "char", 4 }, [26] = { "unsigned", 8 }, [27] = { "const", 5 },
+    [28] = { "break", 5 }, [29] = { "int", 3 }, [33] = { "union", 5 },
+    [37] = { "typedef", 7 }, [41] = { "auto", 4 }, [43] = { "static", 6 },
+    [44] = { "signed", 6 }, [45] = { "goto", 4 }, [46] = { "sizeof", 6 },
+    [48] = { "switch", 6 }, [51] = { "long", 4 }, [55] = { "else", 4 },
+    [57] = { "for", 3 }, [59] = { "short", 5 }, [60] = { "struct", 6 },
+    [61] = { "float", 5 }, [63] = { "enum", 4 }
+};
+
+typedef enum { TOKEN_WORD, TOKEN_NUMBER, TOKEN_LITERAL, TOKEN_PUNCT } TokenKind;
+
+// A token points into the input; it is not NUL-terminated
+typedef struct {
+    const char *start;
+    int length;
+    int line;
+    TokenKind kind;
+} Token;
+
+/*
+ * Tokenizer over text in memory. All of its state is in the struct, so
+ * tokenizers do not interfere with each other, and tokens are slices of
+ * the text rather than copies. Whitespace, comments and preprocessor
+ * lines are skipped; string and character literals are single tokens.
+ */
+typedef struct {
+    const char *pos;
+    const char *end;
+    int line;
+    bool line_start;    // only whitespace since the last newline, so '#' begins a directive
+} Tokenizer;
+
+// A declarator's datatype, interned, with its size worked out
+typedef struct {
+    uint32_t id;            // NO_STRING for an unused cache entry
+    uint8_t size;
+    bool function;
+} DeclType;
+
+#define DECL_TYPE_CACHE 16  // a power of two
+
+// How a word takes part in a declaration's type
+typedef enum { TYPE_NONE, TYPE_QUALIFIER, TYPE_MODIFIER, TYPE_BASE, TYPE_TAG } TypeWord;
+
+#define MAX_TOKENS 256
+
+static StringPool string_pool = { .count = 0 };
 static SymbolTable symbol_table = { .count = 0 };
-bool is_keyword(const char *word);
-bool is_valid_identifier(const char *word);
-int find_symbol(const char *name, const char *scope);
+bool is_keyword(const char *word, size_t length);
+uint32_t hash_string(const char *s, size_t length);
+uint32_t find_string(const char *s, size_t length);
+uint32_t intern_string(const char *s, size_t length);
+const char *pool_string(uint32_t id);
+uint32_t hash_symbol(uint32_t name);
+int find_symbol(const char *name, size_t length);
+int find_symbol_ids(uint32_t name);
+Symbol *insert_symbol(const char *name, size_t length, const char *datatype, int line_number);
+Symbol *insert_symbol_ids(uint32_t name, uint32_t datatype, int memory_usage, int line_number);
+bool enter_scope(const char *name);
+void exit_scope();
 int get_memory_size(const char *datatype);
-void skip_array_tokens(char **token);
 
-void add_symbol(const char *name, const char *datatype, const char *scope, int line_number);
-void parse_declaration(const char *line, int line_number);
+void tokenizer_init(Tokenizer *t, const char *text, size_t length, int first_line);
+bool next_token(Tokenizer *t, Token *token);
+int add_symbol(const Token *name, const DeclType *type, bool is_extern);
+int parse_declaration(const Token *tokens, int i, int n);
+void parse_tokens(const Token *tokens, int n);
 void process_input();
+int process_file(const char *path, bool show_table);
+int generate_source(const char *path, int megabytes);
 void display_symbol_table();
+void display_table_stats();
+
+bool is_keyword(const char *word, size_t length) {
+    if (!word || length < 2) return false;
+    unsigned slot = ((unsigned char)word[0] * 54u + (unsigned char)word[length - 1] + (unsigned)length) &
+                    (KEYWORD_SLOTS - 1);
+    return keyword_slots[slot].length == (int)length && memcmp(keyword_slots[slot].text, word, length) == 0;
+}
 
-bool is_keyword(const char *word) {
+// The linear search is_keyword replaced, kept for the -k benchmark
+static bool is_keyword_linear(const char *word) {
     if (!word) return false;
     
     for (int i = 0; i < MAX_KEYWORDS; i++) {
@@ -51,106 +197,750 @@ bool is_keyword(const char *word) {
     return false;
 }
 
-bool is_valid_identifier(const char *word) {
-    if (!word || strlen(word) == 0) return false;
-    
-    if (!isalpha(word[0]) && word[0] != '_') {
-        return false;
+uint32_t hash_string(const char *s, size_t length) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+// Pool slot holding s, or the empty slot where it would go
+static uint32_t probe_string(const char *s, size_t length, uint32_t hash) {
+    uint32_t mask = string_pool.slot_count - 1;
+    uint32_t i = hash & mask;
+    while (string_pool.slots[i].id != NO_STRING) {
+        const StringSlot *slot = &string_pool.slots[i];
+        const char *text = string_pool.chars + slot->id;
+        if (slot->hash == hash && memcmp(text, s, length) == 0 && text[length] == '\0') break;
+        i = (i + 1) & mask;
     }
-    
-    for (size_t i = 1; i < strlen(word); i++) {
-        if (!isalnum(word[i]) && word[i] != '_') {
-            return false;
+    return i;
+}
+
+// Id of s, or NO_STRING if it was never interned
+uint32_t find_string(const char *s, size_t length) {
+    if (string_pool.slot_count == 0) return NO_STRING;
+    return string_pool.slots[probe_string(s, length, hash_string(s, length))].id;
+}
+
+static bool grow_string_slots() {
+    uint32_t slot_count = string_pool.slot_count ? string_pool.slot_count * 2 : INITIAL_SLOTS;
+    StringSlot *slots = malloc(slot_count * sizeof(StringSlot));
+    if (!slots) return false;
+    for (uint32_t i = 0; i < slot_count; i++) slots[i].id = NO_STRING;
+    for (uint32_t i = 0; i < string_pool.slot_count; i++) {
+        StringSlot slot = string_pool.slots[i];
+        if (slot.id == NO_STRING) continue;
+        uint32_t j = slot.hash & (slot_count - 1);
+        while (slots[j].id != NO_STRING) j = (j + 1) & (slot_count - 1);
+        slots[j] = slot;
+    }
+    free(string_pool.slots);
+    string_pool.slots = slots;
+    string_pool.slot_count = slot_count;
+    return true;
+}
+
+// Id of s, adding it to the pool if needed. Returns NO_STRING if out of memory.
+uint32_t intern_string(const char *s, size_t length) {
+    uint32_t hash = hash_string(s, length);
+    if (string_pool.slot_count > 0) {
+        uint32_t id = string_pool.slots[probe_string(s, length, hash)].id;
+        if (id != NO_STRING) return id;
+    }
+    if ((uint64_t)(string_pool.count + 1) * 100 > (uint64_t)string_pool.slot_count * MAX_LOAD_PERCENT &&
+        !grow_string_slots()) {
+        return NO_STRING;
+    }
+    size_t len = length + 1;
+    if (string_pool.size + len >= NO_STRING) return NO_STRING;
+    if (string_pool.size + len > string_pool.capacity) {
+        size_t capacity = string_pool.capacity ? string_pool.capacity * 2 : 1024;
+        while (capacity < string_pool.size + len) capacity *= 2;
+        char *chars = realloc(string_pool.chars, capacity);
+        if (!chars) return NO_STRING;
+        string_pool.chars = chars;
+        string_pool.capacity = capacity;
+    }
+    uint32_t id = (uint32_t)string_pool.size;
+    memcpy(string_pool.chars + id, s, length);
+    string_pool.chars[id + length] = '\0';
+    string_pool.size += len;
+    string_pool.count++;
+    StringSlot *slot = &string_pool.slots[probe_string(s, length, hash)];
+    slot->id = id;
+    slot->hash = hash;
+    return id;
+}
+
+// Only valid until the next intern_string, which may move the pool
+const char *pool_string(uint32_t id) {
+    return string_pool.chars + id;
+}
+
+uint32_t hash_symbol(uint32_t name) {
+    uint32_t h = name * 0x9E3779B1u;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    return h ^ (h >> 12);
+}
+
+// Slot holding name, or the empty slot where it would go
+static int probe_slot(uint32_t name, uint32_t hash) {
+    int mask = symbol_table.slot_count - 1;
+    int i = (int)(hash & (uint32_t)mask);
+    symbol_table.lookups++;
+    while (true) {
+        symbol_table.probes++;
+        SymbolSlot *slot = &symbol_table.slots[i];
+        if (slot->index < 0) return i;
+        if (slot->hash == hash && symbol_table.table[slot->index].name == name) return i;
+        i = (i + 1) & mask;
+    }
+}
+
+// Innermost visible symbol with an interned name, or -1
+int find_symbol_ids(uint32_t name) {
+    if (symbol_table.slot_count == 0) return -1;
+    return symbol_table.slots[probe_slot(name, hash_symbol(name))].index;
+}
+
+int find_symbol(const char *name, size_t length) {
+    uint32_t name_id = find_string(name, length);
+    return name_id == NO_STRING ? -1 : find_symbol_ids(name_id);
+}
+
+static bool grow_slots() {
+    int slot_count = symbol_table.slot_count ? symbol_table.slot_count * 2 : INITIAL_SLOTS;
+    SymbolSlot *slots = malloc((size_t)slot_count * sizeof(SymbolSlot));
+    if (!slots) return false;
+    for (int i = 0; i < slot_count; i++) slots[i].index = -1;
+    // Rehash from the stored hashes; keys are unique so no compare is needed
+    for (int i = 0; i < symbol_table.slot_count; i++) {
+        SymbolSlot slot = symbol_table.slots[i];
+        if (slot.index < 0) continue;
+        int j = (int)(slot.hash & (uint32_t)(slot_count - 1));
+        while (slots[j].index >= 0) j = (j + 1) & (slot_count - 1);
+        slots[j] = slot;
+    }
+    free(symbol_table.slots);
+    symbol_table.slots = slots;
+    symbol_table.slot_count = slot_count;
+    return true;
+}
+
+// Empties slot i, moving later entries of its probe run back so none is cut off
+static void delete_slot(int i) {
+    int mask = symbol_table.slot_count - 1;
+    int j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (symbol_table.slots[j].index < 0) break;
+        int home = (int)(symbol_table.slots[j].hash & (uint32_t)mask);
+        // Entry j may fill the hole only if its home is not in (i, j]
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            symbol_table.slots[i] = symbol_table.slots[j];
+            i = j;
         }
     }
-    
+    symbol_table.slots[i].index = -1;
+    symbol_table.visible--;
+}
+
+static bool ensure_global_scope() {
+    if (symbol_table.scopes) return true;
+    symbol_table.scopes = malloc(16 * sizeof(Scope));
+    if (!symbol_table.scopes) return false;
+    symbol_table.scope_capacity = 16;
+    symbol_table.scopes[0].name = intern_string("global", 6);
+    symbol_table.scopes[0].undo_start = 0;
+    return symbol_table.scopes[0].name != NO_STRING;
+}
+
+// Opens a scope inside the current one. Returns false if out of memory or too deep.
+bool enter_scope(const char *name) {
+    if (!ensure_global_scope() || symbol_table.depth >= UINT16_MAX) return false;
+    if (symbol_table.depth + 1 == symbol_table.scope_capacity) {
+        int capacity = symbol_table.scope_capacity * 2;
+        Scope *scopes = realloc(symbol_table.scopes, (size_t)capacity * sizeof(Scope));
+        if (!scopes) return false;
+        symbol_table.scopes = scopes;
+        symbol_table.scope_capacity = capacity;
+    }
+    uint32_t name_id = intern_string(name, strlen(name));
+    if (name_id == NO_STRING) return false;
+    Scope *scope = &symbol_table.scopes[++symbol_table.depth];
+    scope->name = name_id;
+    scope->undo_start = symbol_table.undo_count;
     return true;
 }
 
-int find_symbol(const char *name, const char *scope) {
-    for (int i = 0; i < symbol_table.count; i++) {
-        if (strcmp(symbol_table.table[i].name, name) == 0 && 
-            strcmp(symbol_table.table[i].scope, scope) == 0) {
-            return i;
+// Closes the innermost scope, uncovering what its symbols hid
+void exit_scope() {
+    if (symbol_table.depth == 0) return;
+    int start = symbol_table.scopes[symbol_table.depth].undo_start;
+    for (int k = symbol_table.undo_count - 1; k >= start; k--) {
+        const Symbol *sym = &symbol_table.table[symbol_table.undo_log[k]];
+        int i = probe_slot(sym->name, hash_symbol(sym->name));
+        if (sym->shadowed >= 0) {
+            symbol_table.slots[i].index = sym->shadowed;
+        } else {
+            delete_slot(i);
         }
     }
-    return -1;
+    symbol_table.undo_count = start;
+    symbol_table.depth--;
+}
+
+/*
+ * Adds a symbol to the current scope, which must not declare name yet.
+ * Returns NULL if out of memory.
+ */
+Symbol *insert_symbol(const char *name, size_t length, const char *datatype, int line_number) {
+    uint32_t name_id = intern_string(name, length);
+    uint32_t datatype_id = intern_string(datatype, strlen(datatype));
+    if (name_id == NO_STRING || datatype_id == NO_STRING) return NULL;
+    return insert_symbol_ids(name_id, datatype_id, get_memory_size(datatype), line_number);
+}
+
+// insert_symbol for a name and datatype already interned
+Symbol *insert_symbol_ids(uint32_t name_id, uint32_t datatype_id, int memory_usage, int line_number) {
+    if (!ensure_global_scope()) return NULL;
+    if ((long long)(symbol_table.visible + 1) * 100 > (long long)symbol_table.slot_count * MAX_LOAD_PERCENT &&
+        !grow_slots()) {
+        return NULL;
+    }
+    if (symbol_table.count == symbol_table.capacity) {
+        int capacity = symbol_table.capacity ? symbol_table.capacity * 2 : INITIAL_SLOTS;
+        Symbol *table = realloc(symbol_table.table, (size_t)capacity * sizeof(Symbol));
+        if (!table) return NULL;
+        symbol_table.table = table;
+        symbol_table.capacity = capacity;
+    }
+    if (symbol_table.depth > 0 && symbol_table.undo_count == symbol_table.undo_capacity) {
+        int capacity = symbol_table.undo_capacity ? symbol_table.undo_capacity * 2 : INITIAL_SLOTS;
+        int *undo_log = realloc(symbol_table.undo_log, (size_t)capacity * sizeof(int));
+        if (!undo_log) return NULL;
+        symbol_table.undo_log = undo_log;
+        symbol_table.undo_capacity = capacity;
+    }
+    uint32_t hash = hash_symbol(name_id);
+    int i = probe_slot(name_id, hash);
+    int index = symbol_table.count++;
+
+    Symbol *sym = &symbol_table.table[index];
+    sym->name = name_id;
+    sym->datatype = datatype_id;
+    sym->scope = symbol_table.scopes[symbol_table.depth].name;
+    sym->line_number = line_number;
+    sym->shadowed = symbol_table.slots[i].index;
+    sym->memory_usage = (uint8_t)memory_usage;
+    sym->declared_extern = false;
+    sym->defined = false;
+    sym->depth = (uint16_t)symbol_table.depth;
+
+    if (sym->shadowed < 0) symbol_table.visible++;
+    symbol_table.slots[i].index = index;
+    symbol_table.slots[i].hash = hash;
+    // Global symbols are never removed, so only inner scopes log theirs
+    if (symbol_table.depth > 0) symbol_table.undo_log[symbol_table.undo_count++] = index;
+    return sym;
 }
 
 int get_memory_size(const char *datatype) {
     if (!datatype) return 4;
     
-    if (strcmp(datatype, "char") == 0) return 1;
-    if (strcmp(datatype, "short") == 0) return 2;
-    if (strcmp(datatype, "int") == 0) return 4;
-    if (strcmp(datatype, "long") == 0) return 8;
-    if (strcmp(datatype, "float") == 0) return 4;
-    if (strcmp(datatype, "double") == 0) return 8;
-    if (strstr(datatype, "array") != NULL) return 4;
+    if (strstr(datatype, "array") != NULL || strstr(datatype, "function") != NULL) return 4;
+    if (strchr(datatype, '*') != NULL) return (int)sizeof(void *);
+    // Modifiers are part of the type, as in "unsigned char" or "long int"
+    if (strstr(datatype, "char") != NULL) return 1;
+    if (strstr(datatype, "short") != NULL) return 2;
+    if (strstr(datatype, "long") != NULL || strstr(datatype, "double") != NULL) return 8;
     
     return 4;
 }
 
-void skip_array_tokens(char **token) {
-    while (*token && strcmp(*token, "]") != 0) {
-        *token = strtok(NULL, " \t\n;,()");
+// Whether add_symbol reports each identifier it adds; errors are always reported
+static bool report_added = true;
+static int error_count = 0;
+
+/*
+ * The DeclType of datatype, or NULL if out of memory. Whether it declares
+ * a function comes from the caller, as a typedef name may contain
+ * "_function" too, and is part of the cache key. A file uses few
+ * distinct types, so they are kept in a small direct-mapped cache and
+ * a declaration costs one string compare instead of an intern.
+ */
+static const DeclType *decl_type(const char *datatype, bool function) {
+    static DeclType cache[DECL_TYPE_CACHE];
+    static bool cache_ready = false;
+    if (!cache_ready) {
+        for (int i = 0; i < DECL_TYPE_CACHE; i++) cache[i].id = NO_STRING;
+        cache_ready = true;
     }
+    size_t length = strlen(datatype);
+    unsigned slot = ((unsigned char)datatype[0] + (unsigned char)datatype[length - 1] + (unsigned)length + function) &
+                    (DECL_TYPE_CACHE - 1);
+    DeclType *type = &cache[slot];
+    if (type->id != NO_STRING && type->function == function && strcmp(pool_string(type->id), datatype) == 0) {
+        return type;
+    }
+    uint32_t id = intern_string(datatype, length);
+    if (id == NO_STRING) return NULL;
+    type->id = id;
+    type->size = (uint8_t)get_memory_size(datatype);
+    type->function = function;
+    return type;
+}
+
+// Prints a Multiple declaration error for sym, declared again at line
+static void report_redeclaration(const Symbol *sym, int line) {
+    printf("Error: Multiple declaration of '%s' in scope '%s'\n", pool_string(sym->name), pool_string(sym->scope));
+    printf("       First declared at line %d, redeclared at line %d\n", sym->line_number, line);
+    error_count++;
 }
 
-void add_symbol(const char *name, const char *datatype, const char *scope, int line_number) {
-    if (symbol_table.count >= MAX_IDENTIFIERS) {
-        fprintf(stderr, "Error: Symbol table is full!\n");
-        return;
+/*
+ * Declares name with type in the current scope. Returns the index of its
+ * symbol, which is the earlier one for an allowed redeclaration, or -1
+ * after an error.
+ */
+int add_symbol(const Token *name, const DeclType *type, bool is_extern) {
+    if (!ensure_global_scope()) {
+        fprintf(stderr, "Error: Out of memory for symbol table!\n");
+        return -1;
     }
-    
-    int existing = find_symbol(name, scope);
-    if (existing != -1) {
-        printf("Error: Multiple declaration of '%s' in scope '%s'\n", name, scope);
-        printf("       First declared at line %d, redeclared at line %d\n", 
-               symbol_table.table[existing].line_number, line_number);
-        return;
+    if (is_keyword(name->start, (size_t)name->length)) {
+        printf("Error: Cannot use keyword '%.*s' as identifier at line %d\n", name->length, name->start, name->line);
+        error_count++;
+        return -1;
     }
-    
-    if (is_keyword(name)) {
-        printf("Error: Cannot use keyword '%s' as identifier at line %d\n", name, line_number);
-        return;
+
+    // The name is hashed and interned once; a name new to the pool cannot be declared yet
+    uint32_t strings = string_pool.count;
+    uint32_t name_id = intern_string(name->start, (size_t)name->length);
+    if (name_id == NO_STRING) {
+        fprintf(stderr, "Error: Out of memory for symbol table!\n");
+        return -1;
+    }
+    int existing = string_pool.count != strings ? -1 : find_symbol_ids(name_id);
+    if (existing != -1 && symbol_table.table[existing].depth == symbol_table.depth) {
+        // A function may be declared again, as prototypes before or after its one
+        // definition, and so may a variable declared extern; the types must agree
+        Symbol *earlier = &symbol_table.table[existing];
+        if ((type->function || earlier->declared_extern || is_extern) && earlier->datatype == type->id) {
+            if (!is_extern) earlier->declared_extern = false;
+            return existing;
+        }
+        report_redeclaration(earlier, name->line);
+        return -1;
     }
     
-    Symbol *sym = &symbol_table.table[symbol_table.count++];
-    strncpy(sym->name, name, MAX_LENGTH);
-    strncpy(sym->datatype, datatype, MAX_LENGTH);
-    strncpy(sym->scope, scope, MAX_LENGTH);
-    sym->memory_usage = get_memory_size(datatype);
-    sym->line_number = line_number;
+    Symbol *sym = insert_symbol_ids(name_id, type->id, type->size, name->line);
+    if (!sym) {
+        fprintf(stderr, "Error: Out of memory for symbol table!\n");
+        return -1;
+    }
+    sym->declared_extern = is_extern;
+    int index = (int)(sym - symbol_table.table);
     
-    printf("Added identifier '%s' to symbol table\n", name);
+    if (!report_added) return index;
+    printf("Added identifier '%.*s' to symbol table\n", name->length, name->start);
+    if (existing != -1) {
+        const Symbol *outer = &symbol_table.table[existing];
+        printf("       Shadows '%.*s' declared at line %d in scope '%s'\n",
+               name->length, name->start, outer->line_number, pool_string(outer->scope));
+    }
+    return index;
 }
 
-void parse_declaration(const char *line, int line_number) {
-    char buffer[256];
-    strncpy(buffer, line, sizeof(buffer));
-    buffer[sizeof(buffer)-1] = '\0';
-    
-    char *token = strtok(buffer, " \t\n;,()");
-    if (!token) return;
-    
-    char datatype[MAX_LENGTH] = "";
-    strncpy(datatype, token, MAX_LENGTH);
-    const char *scope = "global";
-    
-    while ((token = strtok(NULL, " \t\n;,()")) != NULL) {
-        if (!is_valid_identifier(token)) continue;
-        
-        char final_datatype[MAX_LENGTH];
-        strncpy(final_datatype, datatype, MAX_LENGTH);
-        
-        char *next_token = strtok(NULL, " \t\n;,()");
-        if (next_token && (strcmp(next_token, "[") == 0 || strchr(line, '[') != NULL)) {
-            strncat(final_datatype, "_array", MAX_LENGTH - strlen(final_datatype) - 1);
-            skip_array_tokens(&next_token);
+void tokenizer_init(Tokenizer *t, const char *text, size_t length, int first_line) {
+    t->pos = text;
+    t->end = text + length;
+    t->line = first_line;
+    t->line_start = true;
+}
+
+static inline bool is_word_start(unsigned char c) {
+    return (unsigned)((c | 0x20) - 'a') < 26u || c == '_';
+}
+
+static inline bool is_word_char(unsigned char c) {
+    return is_word_start(c) || (unsigned)(c - '0') < 10u;
+}
+
+// Stores the next token in *token. Returns false at the end of the text.
+bool next_token(Tokenizer *t, Token *token) {
+    const char *p = t->pos, *end = t->end;
+    while (p < end) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '\n') {
+            t->line++;
+            t->line_start = true;
+            p++;
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f') {
+            p++;
+        } else if (c == '/' && p + 1 < end && p[1] == '/') {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            p = nl ? nl : end;
+        } else if (c == '/' && p + 1 < end && p[1] == '*') {
+            for (p += 2; p < end && !(p[0] == '*' && p + 1 < end && p[1] == '/'); p++) {
+                if (*p == '\n') t->line++;
+            }
+            p = p < end ? p + 2 : end;
+        } else if (c == '#' && t->line_start) {
+            // A directive runs to the end of the line, including backslash continuations
+            for (p++; p < end && *p != '\n'; p++) {
+                if (*p == '\\' && p + 1 < end && p[1] == '\n') {
+                    t->line++;
+                    p++;
+                }
+            }
+        } else {
+            break;
         }
-        
-        add_symbol(token, final_datatype, scope, line_number);
+    }
+    t->line_start = false;
+    if (p >= end) {
+        t->pos = end;
+        return false;
+    }
+
+    unsigned char c = (unsigned char)*p;
+    token->start = p;
+    token->line = t->line;
+    if (is_word_start(c)) {
+        for (p++; p < end && is_word_char((unsigned char)*p); p++) {}
+        token->kind = TOKEN_WORD;
+    } else if ((unsigned)(c - '0') < 10u) {
+        for (p++; p < end && (is_word_char((unsigned char)*p) || *p == '.'); p++) {}
+        token->kind = TOKEN_NUMBER;
+    } else if (c == '"' || c == '\'') {
+        for (p++; p < end && *p != (char)c && *p != '\n'; p++) {
+            if (*p == '\\' && p + 1 < end) p++;
+        }
+        if (p < end && *p == (char)c) p++;
+        token->kind = TOKEN_LITERAL;
+    } else {
+        p++;
+        token->kind = TOKEN_PUNCT;
+    }
+    token->length = (int)(p - token->start);
+    t->pos = p;
+    return true;
+}
+
+static bool is_punct(const Token *token, char c) {
+    return token->kind == TOKEN_PUNCT && token->start[0] == c;
+}
+
+static bool token_is(const Token *token, const char *word) {
+    return strlen(word) == (size_t)token->length && memcmp(token->start, word, (size_t)token->length) == 0;
+}
+
+static TypeWord type_word(const Token *token) {
+    static const char *qualifiers[] = { "const", "volatile", "static", "extern", "register", "auto", "typedef" };
+    static const char *modifiers[] = { "signed", "unsigned", "short", "long" };
+    static const char *bases[] = { "char", "int", "float", "double", "void" };
+    static const char *tags[] = { "struct", "union", "enum" };
+    if (token->kind != TOKEN_WORD) return TYPE_NONE;
+    if (!is_keyword(token->start, (size_t)token->length)) {
+        // C99 words that are not among the 32 keywords
+        if (token_is(token, "inline") || token_is(token, "restrict")) return TYPE_QUALIFIER;
+        if (token_is(token, "_Bool")) return TYPE_BASE;
+        return TYPE_NONE;
+    }
+    for (size_t i = 0; i < sizeof(qualifiers) / sizeof(qualifiers[0]); i++) {
+        if (token_is(token, qualifiers[i])) return TYPE_QUALIFIER;
+    }
+    for (size_t i = 0; i < sizeof(modifiers) / sizeof(modifiers[0]); i++) {
+        if (token_is(token, modifiers[i])) return TYPE_MODIFIER;
+    }
+    for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        if (token_is(token, bases[i])) return TYPE_BASE;
+    }
+    for (size_t i = 0; i < sizeof(tags) / sizeof(tags[0]); i++) {
+        if (token_is(token, tags[i])) return TYPE_TAG;
+    }
+    return TYPE_NONE;
+}
+
+// A name or type keyword at i after any '*', as after a typedef name
+static bool declarator_follows(const Token *tokens, int i, int n) {
+    while (i < n && is_punct(&tokens[i], '*')) i++;
+    if (i >= n || tokens[i].kind != TOKEN_WORD) return false;
+    return !is_keyword(tokens[i].start, (size_t)tokens[i].length) || type_word(&tokens[i]) != TYPE_NONE;
+}
+
+// A type keyword, or a typedef name followed by a name with any '*' in between
+static bool starts_declaration(const Token *tokens, int i, int n) {
+    if (tokens[i].kind != TOKEN_WORD) return false;
+    if (type_word(&tokens[i]) != TYPE_NONE) return true;
+    if (is_keyword(tokens[i].start, (size_t)tokens[i].length)) return false;
+    return declarator_follows(tokens, i + 1, n);
+}
+
+// Index past the '}' matching the '{' at i, or i if it is not closed within n
+static int skip_body(const Token *tokens, int i, int n) {
+    int depth = 0;
+    for (int j = i; j < n; j++) {
+        if (is_punct(&tokens[j], '{')) depth++;
+        if (is_punct(&tokens[j], '}') && --depth == 0) return j + 1;
+    }
+    return i;
+}
+
+// Whether the '{' at tokens[i] opens the body of a struct, union or enum
+static bool opens_tag_body(const Token *tokens, int i) {
+    if (i > 0 && type_word(&tokens[i - 1]) == TYPE_TAG) return true;
+    return i > 1 && tokens[i - 1].kind == TOKEN_WORD && type_word(&tokens[i - 2]) == TYPE_TAG;
+}
+
+// Copies text[0..length) into a MAX_LENGTH buffer, cut short if it does not fit
+static void copy_text(char *to, const char *text, size_t length) {
+    if (length > MAX_LENGTH - 1) length = MAX_LENGTH - 1;
+    memcpy(to, text, length);
+    to[length] = '\0';
+}
+
+static void append_text(char *datatype, const char *text, size_t length) {
+    size_t used = strlen(datatype);
+    copy_text(datatype + used, text, length < MAX_LENGTH - used ? length : MAX_LENGTH - used - 1);
+}
+
+static void append_word(char *datatype, const Token *word) {
+    if (datatype[0] != '\0') append_text(datatype, " ", 1);
+    append_text(datatype, word->start, (size_t)word->length);
+}
+
+/*
+ * Reads the type at tokens[i] into datatype: modifiers up to one base
+ * type, a struct/union/enum tag, or a single typedef name. Qualifiers and
+ * storage classes are skipped, and a type of only those is int; *is_extern
+ * tells if extern was among them. Stopping at the base type leaves "int"
+ * in "char int" to be reported as a name. A name followed by a type
+ * keyword, or by a typedef name and a declarator, is a macro such as
+ * ALWAYS_INLINE and is skipped too. A tag's body is skipped, so the
+ * names after it are declared with the tag as their type.
+ */
+static int parse_type(const Token *tokens, int i, int n, char *datatype, bool *is_extern) {
+    datatype[0] = '\0';
+    *is_extern = false;
+    while (i < n && tokens[i].kind == TOKEN_WORD) {
+        TypeWord kind = type_word(&tokens[i]);
+        if (kind == TYPE_QUALIFIER) {
+            if (token_is(&tokens[i], "extern")) *is_extern = true;
+            i++;
+            continue;
+        }
+        if (kind == TYPE_NONE) {
+            TypeWord next = i + 1 < n ? type_word(&tokens[i + 1]) : TYPE_NONE;
+            bool macro = next == TYPE_MODIFIER || next == TYPE_BASE || next == TYPE_TAG ||
+                         (next == TYPE_NONE && starts_declaration(tokens, i + 1, n) &&
+                          declarator_follows(tokens, i + 2, n));
+            if (datatype[0] == '\0' && macro) {
+                i++;
+                continue;
+            }
+            if (datatype[0] == '\0') append_word(datatype, &tokens[i++]);
+            break;
+        }
+        append_word(datatype, &tokens[i++]);
+        if (kind == TYPE_TAG) {
+            if (i < n && tokens[i].kind == TOKEN_WORD) append_word(datatype, &tokens[i++]);
+            if (i < n && is_punct(&tokens[i], '{')) i = skip_body(tokens, i, n);
+            break;
+        }
+        if (kind == TYPE_BASE) break;
+    }
+    if (datatype[0] == '\0') copy_text(datatype, "int", 3);
+    return i;
+}
+
+// Adds a '*' to datatype for each '*' before a declarator's name, skipping qualifiers
+static int parse_pointers(const Token *tokens, int i, int n, char *datatype) {
+    for (; i < n; i++) {
+        if (is_punct(&tokens[i], '*')) {
+            append_text(datatype, "*", 1);
+        } else if (type_word(&tokens[i]) != TYPE_QUALIFIER) {
+            break;
+        }
+    }
+    return i;
+}
+
+// Index past the statement at i, or of the brace that ends it
+static int skip_statement(const Token *tokens, int i, int n) {
+    int depth = 0;
+    for (; i < n; i++) {
+        if (depth == 0 && (is_punct(&tokens[i], '{') || is_punct(&tokens[i], '}'))) return i;
+        if (is_punct(&tokens[i], '(') || is_punct(&tokens[i], '[')) depth++;
+        if ((is_punct(&tokens[i], ')') || is_punct(&tokens[i], ']')) && depth > 0) depth--;
+        if (depth == 0 && is_punct(&tokens[i], ';')) return i + 1;
+    }
+    return n;
+}
+
+// Index of the ',' or ';' that ends the initializer starting at i
+static int skip_initializer(const Token *tokens, int i, int n) {
+    int depth = 0;
+    for (; i < n; i++) {
+        if (depth == 0 && (is_punct(&tokens[i], ',') || is_punct(&tokens[i], ';') || is_punct(&tokens[i], '}'))) break;
+        if (is_punct(&tokens[i], '(') || is_punct(&tokens[i], '[') || is_punct(&tokens[i], '{')) depth++;
+        if (is_punct(&tokens[i], ')') || is_punct(&tokens[i], ']') || is_punct(&tokens[i], '}')) depth--;
+    }
+    return i;
+}
+
+// Skips array bounds at i and marks datatype as an array
+static int parse_array_suffix(const Token *tokens, int i, int n, char *datatype) {
+    if (i >= n || !is_punct(&tokens[i], '[')) return i;
+    append_text(datatype, "_array", 6);
+    while (i < n && is_punct(&tokens[i], '[')) {
+        while (i < n && !is_punct(&tokens[i], ']')) i++;
+        if (i < n) i++;
+    }
+    return i;
+}
+
+// A parameter list was closed: '{' opens the body in the same scope, anything else ends it
+static bool function_body_pending = false;
+// The function whose parameter list it was, or -1, and the line it was declared at
+static int pending_function = -1;
+static int pending_line = 0;
+
+// Opens the function's scope and declares its parameters; i is past the '('
+static int parse_parameters(const Token *tokens, int i, int n, const Token *function) {
+    char name[MAX_LENGTH];
+    copy_text(name, function->start, (size_t)function->length);
+    if (!enter_scope(name)) {
+        fprintf(stderr, "Error: Out of memory for scopes!\n");
+        return n;
+    }
+    while (i < n && !is_punct(&tokens[i], ')')) {
+        if (starts_declaration(tokens, i, n)) {
+            char datatype[MAX_LENGTH];
+            bool is_extern;
+            i = parse_pointers(tokens, parse_type(tokens, i, n, datatype, &is_extern), n, datatype);
+            if (i < n && tokens[i].kind == TOKEN_WORD) {
+                const Token *param = &tokens[i++];
+                i = parse_array_suffix(tokens, i, n, datatype);
+                const DeclType *type = decl_type(datatype, false);
+                if (!type) {
+                    fprintf(stderr, "Error: Out of memory for symbol table!\n");
+                    return n;
+                }
+                add_symbol(param, type, false);
+            }
+        }
+        int depth = 0;
+        for (; i < n; i++) {
+            if (depth == 0 && (is_punct(&tokens[i], ',') || is_punct(&tokens[i], ')'))) break;
+            if (is_punct(&tokens[i], '(')) depth++;
+            if (is_punct(&tokens[i], ')')) depth--;
+        }
+        if (i < n && is_punct(&tokens[i], ',')) i++;
+    }
+    if (i < n) i++;
+    function_body_pending = true;
+    return i;
+}
+
+/*
+ * Declares the names of the declaration starting at tokens[i], which
+ * begins with its type. A name followed by '(' is a function: it is
+ * declared here and its parameters in a new scope named after it.
+ * Returns the index past the declaration.
+ */
+int parse_declaration(const Token *tokens, int i, int n) {
+    char base_type[MAX_LENGTH];
+    bool is_extern;
+    i = parse_type(tokens, i, n, base_type, &is_extern);
+    while (i < n) {
+        char datatype[MAX_LENGTH];
+        copy_text(datatype, base_type, strlen(base_type));
+        i = parse_pointers(tokens, i, n, datatype);
+        if (i >= n || tokens[i].kind != TOKEN_WORD) return skip_statement(tokens, i, n);
+        const Token *name = &tokens[i++];
+
+        bool function = i < n && is_punct(&tokens[i], '(');
+        if (function) {
+            append_text(datatype, "_function", 9);
+        } else {
+            i = parse_array_suffix(tokens, i, n, datatype);
+        }
+        const DeclType *type = decl_type(datatype, function);
+        if (!type) {
+            fprintf(stderr, "Error: Out of memory for symbol table!\n");
+            return n;
+        }
+        int symbol = add_symbol(name, type, is_extern);
+        if (function) {
+            pending_function = symbol;
+            pending_line = name->line;
+            return parse_parameters(tokens, i + 1, n, name);
+        }
+
+        if (i < n && is_punct(&tokens[i], '=')) i = skip_initializer(tokens, i + 1, n);
+        if (i < n && is_punct(&tokens[i], ',')) {
+            i++;
+            continue;
+        }
+        if (i < n && is_punct(&tokens[i], ';')) return i + 1;
+        return skip_statement(tokens, i, n);
+    }
+    return i;
+}
+
+// Declarations, blocks and statements; '{' and '}' open and close scopes
+void parse_tokens(const Token *tokens, int n) {
+    int i = 0;
+    while (i < n) {
+        if (function_body_pending) {
+            function_body_pending = false;
+            if (is_punct(&tokens[i], '{')) {
+                // A second body for the same function is a redeclaration
+                if (pending_function >= 0) {
+                    Symbol *function = &symbol_table.table[pending_function];
+                    if (function->defined) report_redeclaration(function, pending_line);
+                    function->defined = true;
+                }
+                i++;
+                continue;
+            }
+            exit_scope();   // a prototype: its parameters go out of scope
+        }
+        if (is_punct(&tokens[i], '{')) {
+            char name[MAX_LENGTH];
+            snprintf(name, sizeof(name), "block@%d", tokens[i].line);
+            if (!enter_scope(name)) fprintf(stderr, "Error: Out of memory for scopes!\n");
+            i++;
+        } else if (is_punct(&tokens[i], '}')) {
+            if (symbol_table.depth == 0) {
+                printf("Error: Unmatched '}' at line %d\n", tokens[i].line);
+                error_count++;
+            } else {
+                exit_scope();
+            }
+            i++;
+        } else if (starts_declaration(tokens, i, n)) {
+            i = parse_declaration(tokens, i, n);
+        } else {
+            i = skip_statement(tokens, i, n);
+            if (i < n && is_punct(&tokens[i], ';')) i++;
+        }
+    }
+}
+
+// Closes what the input left open
+static void finish_scopes() {
+    if (function_body_pending) {
+        function_body_pending = false;
+        exit_scope();
+    }
+    if (symbol_table.depth > 0) {
+        printf("Error: %d unclosed scope(s) at end of input\n", symbol_table.depth);
+        error_count++;
+        while (symbol_table.depth > 0) exit_scope();
     }
 }
 
@@ -165,9 +955,9 @@ void display_symbol_table() {
     
     for (int i = 0; i < symbol_table.count; i++) {
         printf("| %-15s | %-12s | %-8s | %-10d | %-5d |\n",
-               symbol_table.table[i].name,
-               symbol_table.table[i].datatype,
-               symbol_table.table[i].scope,
+               pool_string(symbol_table.table[i].name),
+               pool_string(symbol_table.table[i].datatype),
+               pool_string(symbol_table.table[i].scope),
                symbol_table.table[i].memory_usage,
                symbol_table.table[i].line_number);
     }
@@ -175,13 +965,200 @@ void display_symbol_table() {
     printf("Total identifiers: %d\n", symbol_table.count);
 }
 
+/*
+ * Load factor and probe lengths. A symbol's displacement is how far its
+ * slot is from where its hash points, so a lookup that finds it examines
+ * displacement + 1 slots.
+ */
+void display_table_stats() {
+    long long total = 0;
+    int longest = 0;
+    int mask = symbol_table.slot_count - 1;
+    for (int i = 0; i < symbol_table.slot_count; i++) {
+        if (symbol_table.slots[i].index < 0) continue;
+        int displacement = (i - (int)(symbol_table.slots[i].hash & (uint32_t)mask)) & mask;
+        total += displacement + 1;
+        if (displacement + 1 > longest) longest = displacement + 1;
+    }
+    printf("Hash slots: %d, visible names: %d, load factor: %.2f\n", symbol_table.slot_count, symbol_table.visible,
+           symbol_table.slot_count ? (double)symbol_table.visible / symbol_table.slot_count : 0.0);
+    printf("Probe length for a hit: average %.2f, longest %d\n",
+           symbol_table.visible ? (double)total / symbol_table.visible : 0.0, longest);
+    printf("Lookups: %llu, average slots examined: %.2f\n", symbol_table.lookups,
+           symbol_table.lookups ? (double)symbol_table.probes / symbol_table.lookups : 0.0);
+
+    // The layout before interning: three char[MAX_LENGTH] fields in every symbol
+    size_t inline_size = sizeof(struct {
+        char name[MAX_LENGTH];
+        char datatype[MAX_LENGTH];
+        char scope[MAX_LENGTH];
+        int memory_usage;
+        int line_number;
+    });
+    size_t pool_bytes = string_pool.size + (size_t)string_pool.slot_count * sizeof(StringSlot);
+    size_t table_bytes = (size_t)symbol_table.count * sizeof(Symbol) +
+                         (size_t)symbol_table.slot_count * sizeof(SymbolSlot);
+    printf("Symbol record: %zu bytes (%zu with inline strings)\n", sizeof(Symbol), inline_size);
+    printf("Strings interned: %u, %zu bytes of text\n", string_pool.count, string_pool.size);
+    if (symbol_table.count > 0) {
+        printf("Bytes per symbol: %.1f with hash slots and string pool (%.1f with inline strings)\n",
+               (double)(table_bytes + pool_bytes) / symbol_table.count,
+               (double)((size_t)symbol_table.count * inline_size +
+                        (size_t)symbol_table.slot_count * sizeof(SymbolSlot)) / symbol_table.count);
+    }
+}
+
+static double seconds_since(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/*
+ * Declares count generated symbols without printing them. The first half
+ * are globals with distinct names. The rest go into nested blocks, 64 to
+ * a block and up to 8 blocks deep: half reuse the names of the first 32
+ * globals, so each block hides the one around it, and half are names no
+ * global has, which leave the table when the last block declaring them
+ * closes. Every declaration and every return to global scope is checked
+ * to leave the innermost symbol visible, and the globals are looked up
+ * again at the end. Names are formatted before the clock starts.
+ */
+int stress_symbol_table(int count) {
+    static const char *types[] = { "int", "char", "float", "double" };
+    int globals = count / 2 > 64 ? count / 2 : (count < 64 ? count : 64);
+    char (*names)[16] = malloc((size_t)(globals > 0 ? globals : 1) * sizeof(*names));
+    if (!names) {
+        fprintf(stderr, "Error: Out of memory for symbol names!\n");
+        return 1;
+    }
+    char local_names[32][16];
+    for (int i = 0; i < globals; i++) snprintf(names[i], sizeof(names[i]), "sym_%d", i);
+    for (int i = 0; i < 32; i++) snprintf(local_names[i], sizeof(local_names[i]), "local_%d", i);
+
+    clock_t start = clock();
+    for (int i = 0; i < globals; i++) {
+        if (find_symbol(names[i], strlen(names[i])) != -1) continue;
+        if (!insert_symbol(names[i], strlen(names[i]), types[i % 4], i + 1)) {
+            fprintf(stderr, "Error: Out of memory for symbol table!\n");
+            free(names);
+            return 1;
+        }
+    }
+    double global_seconds = seconds_since(start);
+
+    int block_names = globals < 32 ? 2 * globals : 64;
+    int locals = 0, blocks = 0, exits = 0, wrong = 0;
+    double exit_seconds = 0;
+    start = clock();
+    while (locals < count - globals && block_names > 0) {
+        enter_scope("block");
+        blocks++;
+        for (int j = 0; j < block_names && locals < count - globals; j++, locals++) {
+            const char *name = j % 2 ? local_names[j / 2] : names[j / 2];
+            Symbol *sym = insert_symbol(name, strlen(name), types[j % 4], globals + locals + 1);
+            if (!sym) {
+                fprintf(stderr, "Error: Out of memory for symbol table!\n");
+                free(names);
+                return 1;
+            }
+            if (find_symbol_ids(sym->name) != (int)(sym - symbol_table.table)) wrong++;
+        }
+        if (symbol_table.depth < 8 && locals < count - globals) continue;
+        clock_t exit_start = clock();
+        while (symbol_table.depth > 0) {
+            exit_scope();
+            exits++;
+        }
+        exit_seconds += seconds_since(exit_start);
+        // Back at global scope, names[0] is the global again and no local is left
+        int index = find_symbol(names[0], strlen(names[0]));
+        if (index < 0 || symbol_table.table[index].depth != 0) wrong++;
+        for (int j = 0; j < 32; j++) {
+            if (find_symbol(local_names[j], strlen(local_names[j])) != -1) wrong++;
+        }
+    }
+    double block_seconds = seconds_since(start) - exit_seconds;
+
+    int found = 0;
+    start = clock();
+    for (int i = 0; i < globals; i++) {
+        int index = find_symbol(names[i], strlen(names[i]));
+        if (index >= 0 && symbol_table.table[index].depth == 0) found++;
+    }
+    double lookup_seconds = seconds_since(start);
+    free(names);
+
+    printf("Globals: %d, block symbols: %d in %d blocks, scope exits: %d\n", globals, locals, blocks, exits);
+    printf("Wrong innermost symbol: %d, globals found again: %d\n", wrong, found);
+    printf("Global insert: %.1f ns/symbol, block insert and check: %.1f ns/symbol\n",
+           globals ? global_seconds * 1e9 / globals : 0.0, locals ? block_seconds * 1e9 / locals : 0.0);
+    printf("Scope exit: %.1f ns per symbol removed, lookup: %.1f ns/symbol\n",
+           locals ? exit_seconds * 1e9 / locals : 0.0, globals ? lookup_seconds * 1e9 / globals : 0.0);
+    display_table_stats();
+    return wrong == 0 && found == globals ? 0 : 1;
+}
+
+/*
+ * Times is_keyword against the linear search over a mix of the 32
+ * keywords and 94 identifiers, some of them keyword prefixes or the same
+ * length as a keyword, after checking that both agree on every word.
+ */
+int benchmark_keywords(int rounds) {
+    static const char *identifiers[] = {
+        "i", "j", "n", "x", "y", "id", "in", "on", "fo", "el", "au", "ch", "ints", "dou", "forx", "iff",
+        "count", "index", "total", "value", "buffer", "length", "result", "node", "next", "prev", "head", "tail",
+        "data", "size", "left", "right", "line", "word", "flag", "temp", "sum", "max", "min", "avg",
+        "automat", "breaker", "cased", "chars", "constant", "continues", "defaults", "doubled", "elsewhere",
+        "enumerate", "externs", "floats", "format", "gotos", "iffy", "integer", "longer", "registers", "returned",
+        "shorter", "signedness", "sizeofs", "statics", "structure", "switches", "typedefs", "unions", "unsigned_",
+        "voids", "volatility", "whiles", "Int", "WHILE", "Return", "_static", "char_", "do_", "if_",
+        "struct2", "unionx", "voidp", "floaty", "ctype", "stdio", "printf", "scanf", "malloc", "free",
+        "main", "argc", "argv", "strlen", "memcpy", "errno"
+    };
+    int identifier_count = (int)(sizeof(identifiers) / sizeof(identifiers[0]));
+    const char *words[MAX_KEYWORDS + sizeof(identifiers) / sizeof(identifiers[0])];
+    size_t lengths[MAX_KEYWORDS + sizeof(identifiers) / sizeof(identifiers[0])];
+    int word_count = 0;
+    for (int i = 0; i < MAX_KEYWORDS; i++) words[word_count++] = KEYWORDS[i];
+    for (int i = 0; i < identifier_count; i++) words[word_count++] = identifiers[i];
+    for (int i = 0; i < word_count; i++) lengths[i] = strlen(words[i]);
+
+    int keywords_found = 0;
+    for (int i = 0; i < word_count; i++) {
+        if (is_keyword(words[i], lengths[i]) != is_keyword_linear(words[i])) {
+            printf("Mismatch on '%s'\n", words[i]);
+            return 1;
+        }
+        keywords_found += is_keyword(words[i], lengths[i]);
+    }
+
+    volatile int sink = 0;
+    clock_t start = clock();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < word_count; i++) sink += is_keyword_linear(words[i]);
+    }
+    double linear_seconds = seconds_since(start);
+    start = clock();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < word_count; i++) sink += is_keyword(words[i], lengths[i]);
+    }
+    double hash_seconds = seconds_since(start);
+
+    double calls = (double)rounds * word_count;
+    printf("Words: %d (%d keywords), rounds: %d\n", word_count, keywords_found, rounds);
+    printf("Linear search: %.1f ns/word, perfect hash: %.1f ns/word, speedup %.1fx\n",
+           linear_seconds * 1e9 / calls, hash_seconds * 1e9 / calls,
+           hash_seconds > 0 ? linear_seconds / hash_seconds : 0.0);
+    return 0;
+}
+
 void process_input() {
     char line[256];
+    Token tokens[MAX_TOKENS];
     int line_number = 1;
     
     printf("Symbol Table Constructor and Error Detector\n");
     printf("============================================\n\n");
-    printf("Enter C declarations (one per line). Enter 'END' to finish:\n");
+    printf("Enter C declarations (one per line), with { and } for blocks. Enter 'END' to finish:\n");
     
     while (true) {
         printf("Line %d: ", line_number);
@@ -192,14 +1169,174 @@ void process_input() {
         if (strcmp(line, "END") == 0) break;
         if (strlen(line) == 0) continue;
         
-        parse_declaration(line, line_number);
+        Tokenizer tokenizer;
+        int n = 0;
+        tokenizer_init(&tokenizer, line, strlen(line), line_number);
+        while (n < MAX_TOKENS && next_token(&tokenizer, &tokens[n])) n++;
+        parse_tokens(tokens, n);
         line_number++;
     }
+
+    finish_scopes();
 }
 
-int main() {
+static char *read_file(const char *path, size_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open '%s'\n", path);
+        return NULL;
+    }
+    char *text = NULL;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long size = ftell(file);
+        if (size >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+            text = malloc((size_t)size + 1);
+            if (text) *length = fread(text, 1, (size_t)size, file);
+        }
+    }
+    fclose(file);
+    if (!text) fprintf(stderr, "Error: Cannot read '%s'\n", path);
+    return text;
+}
+
+/*
+ * Declares every name in a whole C file. The file is read once and its
+ * tokens are gathered into statements, so a declaration may span lines:
+ * a statement ends at ';', '{' or '}' outside parentheses, initializers
+ * and struct, union or enum bodies. Errors are printed as they are
+ * found, then a summary.
+ */
+int process_file(const char *path, bool show_table) {
+    size_t length = 0;
+    char *text = read_file(path, &length);
+    if (!text) return 1;
+
+    int capacity = MAX_TOKENS;
+    Token *tokens = malloc((size_t)capacity * sizeof(Token));
+    if (!tokens) {
+        fprintf(stderr, "Error: Out of memory for tokens!\n");
+        free(text);
+        return 1;
+    }
+
+    report_added = false;
+    clock_t start = clock();
+    Tokenizer tokenizer;
+    tokenizer_init(&tokenizer, text, length, 1);
+    long token_count = 0;
+    int n = 0, parens = 0, nested = 0;
+    while (next_token(&tokenizer, &tokens[n])) {
+        const Token *token = &tokens[n++];
+        token_count++;
+        bool end = false;
+        if (token->kind == TOKEN_PUNCT) {
+            switch (token->start[0]) {
+            case '(': parens++; break;
+            case ')': if (parens > 0) parens--; break;
+            case '{':
+                // A brace right after '=' starts an initializer and one after a tag its body, not a block
+                if (nested > 0 || (n > 1 && is_punct(token - 1, '=')) || opens_tag_body(tokens, n - 1)) nested++;
+                else end = parens == 0;
+                break;
+            case '}':
+                if (nested > 0) nested--;
+                else end = parens == 0;
+                break;
+            case ';':
+                end = parens == 0 && nested == 0;
+                break;
+            }
+        }
+        if (end) {
+            parse_tokens(tokens, n);
+            n = 0;
+            parens = 0;
+            nested = 0;
+        } else if (n == capacity) {
+            Token *grown = realloc(tokens, (size_t)capacity * 2 * sizeof(Token));
+            if (!grown) {
+                fprintf(stderr, "Error: Out of memory for tokens!\n");
+                free(tokens);
+                free(text);
+                return 1;
+            }
+            tokens = grown;
+            capacity *= 2;
+        }
+    }
+    parse_tokens(tokens, n);
+    finish_scopes();
+    double seconds = seconds_since(start);
+
+    double megabytes = length / (1024.0 * 1024.0);
+    int lines = length == 0 ? 0 : tokenizer.line - (text[length - 1] == '\n');
+    printf("File: %s, %.2f MB, %d lines, %ld tokens\n", path, megabytes, lines, token_count);
+    printf("Symbols: %d, errors: %d\n", symbol_table.count, error_count);
+    printf("Time: %.3f s, %.1f MB/s\n", seconds, seconds > 0 ? megabytes / seconds : 0.0);
+    if (show_table) {
+        display_symbol_table();
+        display_table_stats();
+    }
+    free(tokens);
+    free(text);
+    report_added = true;
+    return error_count == 0 ? 0 : 2;
+}
+
+/*
+ * Writes about MEGABYTES of C for -f: globals, declarations over several
+ * lines, comments, directives and functions with parameters and nested
+ * blocks. Every name is declared once in its scope.
+ */
+int generate_source(const char *path, int megabytes) {
+    static const char *types[] = { "int", "unsigned long", "const char *", "double", "struct node *", "short" };
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot create '%s'\n", path);
+        return 1;
+    }
+    long target = (long)megabytes * 1024 * 1024;
+    fprintf(file, "#include <stdio.h>\n#define LIMIT(x) \\\n    ((x) > 10 ? 10 : (x))\n\n");
+    for (int unit = 0; unit == 0 || ftell(file) < target; unit++) {
+        const char *type = types[unit % 6];
+        fprintf(file, "/* Unit %d: globals and a function using them */\n", unit);
+        fprintf(file, "static %s g%d_a, g%d_b = 4;\n", type, unit, unit);
+        fprintf(file, "int g%d_table[16] = { 1, 2, 3,\n    4, 5, 6 },\n    g%d_count;\n", unit, unit);
+        fprintf(file, "long f%d(int a, %s b, char name[]);\n\n", unit, type);
+        fprintf(file, "long f%d(int a, %s b, char name[])\n{\n", unit, type);
+        fprintf(file, "    int i, total = 0;   // running sum\n");
+        fprintf(file, "    const char *label = \"unit; %d {\";\n", unit);
+        fprintf(file, "    for (i = 0; i < a; i++) {\n");
+        fprintf(file, "        unsigned int step = i * 2,\n            extra = LIMIT(i);\n");
+        fprintf(file, "        total += step + extra + name[i];\n    }\n");
+        fprintf(file, "    if (total > 100) {\n        double scale = total / 3.0;\n");
+        fprintf(file, "        total = (int)scale;\n    }\n");
+        fprintf(file, "    return total + (label[0] == 'u');\n}\n\n");
+    }
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "-s") == 0) return stress_symbol_table(atoi(argv[2]));
+    if (argc == 3 && strcmp(argv[1], "-k") == 0) return benchmark_keywords(atoi(argv[2]));
+    if (argc == 3 && strcmp(argv[1], "-f") == 0) return process_file(argv[2], false);
+    if (argc == 4 && strcmp(argv[1], "-f") == 0 && strcmp(argv[3], "-t") == 0) return process_file(argv[2], true);
+    if (argc == 5 && strcmp(argv[1], "-g") == 0 && strcmp(argv[3], "-f") == 0) {
+        return generate_source(argv[4], atoi(argv[2]));
+    }
+    if (argc != 1) {
+        fprintf(stderr, "Usage: %s [-s COUNT | -k ROUNDS | -f FILE [-t] | -g MB -f FILE]\n", argv[0]);
+        fprintf(stderr, "  -s COUNT  declare COUNT generated symbols in global and nested scopes and print table statistics\n");
+        fprintf(stderr, "  -k ROUNDS time is_keyword against a linear search over ROUNDS passes of a word list\n");
+        fprintf(stderr, "  -f FILE   declare every name in the C file FILE and report errors and throughput; -t prints the table\n");
+        fprintf(stderr, "  -g MB     write about MB megabytes of generated C declarations and functions to FILE\n");
+        return 1;
+    }
+
     process_input();
     display_symbol_table();
+    display_table_stats();
     printf("\nProgram completed successfully!\n");
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,54 @@
+#!/bin/sh
+# Runs practical02's whole-file mode (-f) over the repo's own C sources,
+# which must all pass with no errors reported.
+#
+#   ./practical02_check.sh
+#
+# lex.yy.c is left out: it is pre-ANSI flex output whose prototypes go
+# through the YY_PROTO macro and whose definitions appear once for each
+# side of #ifdef YY_USE_PROTOS. practical02 skips preprocessor lines and
+# sees both sides.
+#
+# A fixture then checks that names declared after a struct, union or enum
+# body reach the table.
+#
+# Needs cc. The binary and fixture go to practical02_check/.
+
+set -e
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+
+cd "$(dirname "$0")"
+WORK=practical02_check
+mkdir -p "$WORK"
+"$CC" $CFLAGS -o "$WORK/practical02" practical02.c
+
+status=0
+for source in ./*.c; do
+    [ "$source" = ./lex.yy.c ] && continue
+    if "$WORK/practical02" -f "$source" > "$WORK/check.out"; then
+        echo "$source: $(grep '^Symbols' "$WORK/check.out")"
+    else
+        echo "$source: errors reported" >&2
+        grep '^Error\|^       ' "$WORK/check.out" >&2
+        status=1
+    fi
+done
+
+cat > "$WORK/tags.c" <<'EOF'
+struct point { int x; int y; } origin, *cursor;
+enum color { RED, GREEN } paint;
+union value { int i; struct { char c; } inner; } cell[4];
+EOF
+"$WORK/practical02" -f "$WORK/tags.c" -t > "$WORK/check.out" || status=1
+for name in origin cursor paint cell; do
+    if ! grep -q "^| $name " "$WORK/check.out"; then
+        echo "tags.c: '$name' missing from the table" >&2
+        status=1
+    fi
+done
+echo "tags.c: $(grep '^Symbols' "$WORK/check.out")"
+
+rm -f "$WORK/check.out" "$WORK/tags.c"
+exit $status
@@ -2,9 +2,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
 
 #define MAX_STACK 200
 #define MAX_INPUT 200
+#define RING_SLOTS 64           /* token batches in flight between the two threads; a power of two */
+#define DEFAULT_BATCH 4096      /* tokens per batch */
+#define CACHE_LINE 64
 
 // Token types (terminals first)
 typedef enum {
@@ -215,7 +224,450 @@ int parse_expression() {
     }
 }
 
-int main() {
+/*
+ * Batch mode: FILE holds one expression per line and each is parsed
+ * without the step trace, only counting how many are accepted.
+ *
+ *   gcc -O2 -o practical05 practical05.c -lpthread
+ *   ./practical05 -g 64 -f exprs.txt        write about 64 MB of expressions
+ *   ./practical05 -f exprs.txt [-j 1|2] [-n BATCH]
+ *   ./practical05 -f exprs.txt -b           sweep batch sizes, 1 and 2 threads
+ *
+ * The lexer turns the file into token kinds in batches of BATCH tokens,
+ * with a T_END closing every non-empty line. With -j 1 the parser lexes
+ * each batch itself when it runs out. With -j 2 (the default) the lexer
+ * runs on its own thread and hands full batches to the parser through a
+ * single-producer/single-consumer ring, so lexing and parsing overlap.
+ * The ring is lock-free: each side owns one index and publishes it with a
+ * release store that the other side reads with an acquire load.
+ */
+
+// Lexer over the whole input; pos and line_start carry over between batches
+typedef struct {
+    const char *text;
+    size_t len;
+    size_t pos;
+    size_t line_start;
+} ExprLexer;
+
+// Lexes up to cap tokens into out. Returns how many; 0 at end of input.
+static size_t lex_batch(ExprLexer *lx, uint8_t *out, size_t cap) {
+    const char *s = lx->text;
+    size_t n = lx->len, i = lx->pos, count = 0;
+    while (count < cap && i < n) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '\n') {
+            if (i > lx->line_start) out[count++] = T_END;
+            lx->line_start = ++i;
+            continue;
+        }
+        if (isspace(c)) {
+            i++;
+            continue;
+        }
+        switch (c) {
+            case '+': out[count++] = T_PLUS; i++; continue;
+            case '*': out[count++] = T_MUL; i++; continue;
+            case '(': out[count++] = T_LPAREN; i++; continue;
+            case ')': out[count++] = T_RPAREN; i++; continue;
+        }
+        if (isalpha(c) || c == '_') {
+            i++;
+            while (i < n && (isalnum((unsigned char)s[i]) || s[i] == '_')) i++;
+            out[count++] = T_ID;
+            continue;
+        }
+        // Unknown char ends the expression, as in get_next_token; the rest of the line is dropped
+        out[count++] = T_END;
+        const char *nl = memchr(s + i, '\n', n - i);
+        i = nl ? (size_t)(nl - s) + 1 : n;
+        lx->line_start = i;
+    }
+    if (count < cap && i == n && i > lx->line_start) {
+        out[count++] = T_END;
+        lx->line_start = i;
+    }
+    lx->pos = i;
+    return count;
+}
+
+// Single-producer/single-consumer ring of token batches
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_size_t head;    // batches the parser has finished with
+    _Alignas(CACHE_LINE) atomic_size_t tail;    // batches the lexer has filled
+    atomic_bool done;                           // set once the lexer has published its last batch
+    _Alignas(CACHE_LINE) size_t counts[RING_SLOTS];
+    size_t batch_size;
+    uint8_t *tokens;                            // RING_SLOTS * batch_size kinds
+} TokenRing;
+
+static void spin_wait(unsigned *spins) {
+    if (++*spins % 64 == 0) sched_yield();
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    else __builtin_ia32_pause();
+#endif
+}
+
+typedef struct {
+    TokenRing *ring;
+    ExprLexer *lexer;
+} LexerThreadArgs;
+
+static void *lexer_thread(void *arg) {
+    LexerThreadArgs *a = arg;
+    TokenRing *ring = a->ring;
+    size_t tail = 0, head = 0;
+    unsigned spins = 0;
+    for (;;) {
+        // Only re-read head when the ring looks full
+        while (tail - head == RING_SLOTS) {
+            head = atomic_load_explicit(&ring->head, memory_order_acquire);
+            if (tail - head == RING_SLOTS) spin_wait(&spins);
+        }
+        size_t slot = tail & (RING_SLOTS - 1);
+        size_t n = lex_batch(a->lexer, ring->tokens + slot * ring->batch_size, ring->batch_size);
+        if (n == 0) break;
+        ring->counts[slot] = n;
+        atomic_store_explicit(&ring->tail, ++tail, memory_order_release);
+    }
+    atomic_store_explicit(&ring->done, true, memory_order_release);
+    return NULL;
+}
+
+// The parser's view of the tokens: the current batch and how to get the next one
+typedef struct TokenReader {
+    const uint8_t *tokens;
+    size_t count;
+    size_t pos;
+    size_t total;
+    bool (*refill)(struct TokenReader *r);
+    ExprLexer *lexer;       // -j 1: lex into own_batch
+    uint8_t *own_batch;
+    size_t batch_size;
+    TokenRing *ring;        // -j 2: take batches from the ring
+    size_t head, tail;
+    bool holding;           // the batch at head is still being read
+} TokenReader;
+
+static bool refill_from_lexer(TokenReader *r) {
+    r->count = lex_batch(r->lexer, r->own_batch, r->batch_size);
+    r->tokens = r->own_batch;
+    r->pos = 0;
+    r->total += r->count;
+    return r->count > 0;
+}
+
+static bool refill_from_ring(TokenReader *r) {
+    TokenRing *ring = r->ring;
+    if (r->holding) {
+        atomic_store_explicit(&ring->head, ++r->head, memory_order_release);
+        r->holding = false;
+    }
+    unsigned spins = 0;
+    while (r->tail == r->head) {
+        r->tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (r->tail != r->head) break;
+        if (atomic_load_explicit(&ring->done, memory_order_acquire)) {
+            // done is stored after the last tail, so this read sees every batch
+            r->tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+            if (r->tail == r->head) return false;
+            break;
+        }
+        spin_wait(&spins);
+    }
+    size_t slot = r->head & (RING_SLOTS - 1);
+    r->tokens = ring->tokens + slot * ring->batch_size;
+    r->count = ring->counts[slot];
+    r->pos = 0;
+    r->total += r->count;
+    r->holding = true;
+    return true;
+}
+
+// Whether another expression follows, refilling if the batch is used up
+static bool reader_more(TokenReader *r) {
+    return r->pos < r->count || r->refill(r);
+}
+
+// Every expression ends with T_END, so within one a refill always succeeds
+static TokenType read_token(TokenReader *r) {
+    if (r->pos == r->count && !r->refill(r)) return T_END;
+    return (TokenType)r->tokens[r->pos++];
+}
+
+// reduce_once without the trace
+static int reduce_quiet() {
+    if (top_ >= 2 && stack_[top_] == T_E && stack_[top_ - 2] == T_E &&
+        (stack_[top_ - 1] == T_PLUS || stack_[top_ - 1] == T_MUL)) {
+        top_ -= 2;
+        return 1;
+    }
+    if (top_ >= 2 && stack_[top_] == T_RPAREN && stack_[top_ - 1] == T_E && stack_[top_ - 2] == T_LPAREN) {
+        top_ -= 2;
+        stack_[top_] = T_E;
+        return 1;
+    }
+    if (top_ >= 0 && stack_[top_] == T_ID) {
+        stack_[top_] = T_E;
+        return 1;
+    }
+    return 0;
+}
+
+// parse_expression without the trace, reading one line's tokens from r
+static int parse_quiet(TokenReader *r) {
+    int accepted = -1;
+    top_ = -1;
+    stack_[++top_] = T_END;
+    TokenType a = read_token(r);
+    while (accepted < 0) {
+        int action = precedence_table[top_terminal()][a];
+        if (action == 1 || action == 3) {
+            if (top_ >= MAX_STACK - 1) {
+                accepted = 0;
+            } else {
+                stack_[++top_] = a;
+                a = read_token(r);
+            }
+        } else if (action == 2) {
+            if (!reduce_quiet()) accepted = 0;
+        } else if (action == 4) {
+            accepted = 1;
+        } else {
+            accepted = a == T_END && top_ == 1 && stack_[0] == T_END && stack_[1] == T_E;
+        }
+    }
+    // A failed parse may stop before the end of its line
+    while (a != T_END) a = read_token(r);
+    return accepted;
+}
+
+typedef struct {
+    size_t expressions;
+    size_t accepted;
+    size_t tokens;
+} BatchResult;
+
+static bool parse_all(TokenReader *r, BatchResult *res) {
+    while (reader_more(r)) {
+        res->expressions++;
+        res->accepted += parse_quiet(r);
+    }
+    res->tokens = r->total;
+    return true;
+}
+
+// Parses every line of text[0..len) on 1 or 2 threads
+static bool parse_batch(const char *text, size_t len, int threads, size_t batch_size, BatchResult *res) {
+    ExprLexer lexer = { text, len, 0, 0 };
+    TokenReader reader = { 0 };
+    reader.batch_size = batch_size;
+    memset(res, 0, sizeof(*res));
+
+    if (threads < 2) {
+        reader.lexer = &lexer;
+        reader.own_batch = malloc(batch_size);
+        reader.refill = refill_from_lexer;
+        if (!reader.own_batch) return false;
+        parse_all(&reader, res);
+        free(reader.own_batch);
+        return true;
+    }
+
+    TokenRing *ring = aligned_alloc(CACHE_LINE, sizeof(TokenRing));
+    if (!ring) return false;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->done, false);
+    ring->batch_size = batch_size;
+    ring->tokens = malloc(RING_SLOTS * batch_size);
+    if (!ring->tokens) {
+        free(ring);
+        return false;
+    }
+    reader.ring = ring;
+    reader.refill = refill_from_ring;
+
+    LexerThreadArgs args = { ring, &lexer };
+    pthread_t tid;
+    bool ok = pthread_create(&tid, NULL, lexer_thread, &args) == 0;
+    if (ok) {
+        parse_all(&reader, res);
+        pthread_join(tid, NULL);
+    }
+    free(ring->tokens);
+    free(ring);
+    return ok;
+}
+
+static char *read_whole_file(const char *path, size_t *len) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        fprintf(stderr, "Error: Cannot open file %s\n", path);
+        return NULL;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    char *text = size >= 0 ? malloc((size_t)size + 1) : NULL;
+    if (!text || fread(text, 1, (size_t)size, in) != (size_t)size) {
+        fprintf(stderr, "Error: Cannot read file %s\n", path);
+        free(text);
+        fclose(in);
+        return NULL;
+    }
+    fclose(in);
+    *len = (size_t)size;
+    return text;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int parse_file(const char *path, int threads, size_t batch_size) {
+    size_t len = 0;
+    char *text = read_whole_file(path, &len);
+    if (!text) return 1;
+    BatchResult res;
+    double start = now_seconds();
+    bool ok = parse_batch(text, len, threads, batch_size, &res);
+    double elapsed = now_seconds() - start;
+    free(text);
+    if (!ok) {
+        fprintf(stderr, "Error: Cannot start the parser\n");
+        return 1;
+    }
+    printf("Expressions: %zu, accepted: %zu, rejected: %zu, tokens: %zu\n",
+           res.expressions, res.accepted, res.expressions - res.accepted, res.tokens);
+    printf("Threads: %d, batch: %zu tokens, %.3f s, %.1f MB/s\n",
+           threads < 2 ? 1 : 2, batch_size, elapsed, (double)len / 1e6 / elapsed);
+    return 0;
+}
+
+/*
+ * Throughput on path for batch sizes from 16 to 64K tokens, single-threaded
+ * and pipelined. Each setting keeps the best of `runs` passes; the counts
+ * of every pass are checked against a first untimed one.
+ */
+int benchmark_batches(const char *path, int runs) {
+    size_t len = 0;
+    char *text = read_whole_file(path, &len);
+    if (!text) return 1;
+    BatchResult warm;
+    if (!parse_batch(text, len, 1, DEFAULT_BATCH, &warm)) {
+        free(text);
+        return 1;
+    }
+
+    printf("Input: %s (%.1f MB, %zu expressions, %zu tokens), best of %d runs\n",
+           path, (double)len / 1e6, warm.expressions, warm.tokens, runs);
+    printf("%-8s | %-13s | %-14s | %-8s\n", "Batch", "1 thread MB/s", "2 threads MB/s", "Speedup");
+    printf("---------+---------------+----------------+---------\n");
+    for (size_t batch = 16; batch <= 65536; batch *= 4) {
+        double rate[2];
+        bool match = true;
+        for (int t = 0; t < 2; t++) {
+            double best = 0;
+            for (int r = 0; r < runs; r++) {
+                BatchResult res;
+                double start = now_seconds();
+                parse_batch(text, len, t + 1, batch, &res);
+                double elapsed = now_seconds() - start;
+                if (best == 0 || elapsed < best) best = elapsed;
+                match = match && res.accepted == warm.accepted && res.tokens == warm.tokens;
+            }
+            rate[t] = (double)len / 1e6 / best;
+        }
+        printf("%-8zu | %-13.1f | %-14.1f | %.2f%s\n", batch, rate[0], rate[1], rate[1] / rate[0],
+               match ? "" : " MISMATCH");
+    }
+    free(text);
+    return 0;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 32);
+}
+
+static void write_expression(FILE *out, int depth) {
+    static const char *ids[] = { "a", "b", "c", "x1", "total", "rate", "_tmp", "count" };
+    uint32_t pick = next_random() % 8;
+    if (depth == 0 || pick < 3) {
+        fputs(ids[next_random() % 8], out);
+    } else if (pick < 7) {
+        write_expression(out, depth - 1);
+        fputs(pick & 1 ? " + " : " * ", out);
+        write_expression(out, depth - 1);
+    } else {
+        fputc('(', out);
+        write_expression(out, depth - 1);
+        fputc(')', out);
+    }
+}
+
+// Writes about mb MB of expressions to path; roughly one line in 16 has a syntax error
+int generate_expressions(const char *path, int mb) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot write file %s\n", path);
+        return 1;
+    }
+    while (ftell(out) < (long)mb * 1000000L) {
+        write_expression(out, 5);
+        if (next_random() % 16 == 0) fputs(next_random() & 1 ? " +" : " )", out);
+        fputc('\n', out);
+    }
+    return fclose(out) == 0 ? 0 : 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-f FILE [-j 1|2] [-n BATCH] [-b] [-g MB]]\n", prog);
+    fprintf(stderr, "  -f FILE   parse every line of FILE quietly and count accepted expressions\n");
+    fprintf(stderr, "  -j N      1 = lex and parse on one thread, 2 = pipelined (default)\n");
+    fprintf(stderr, "  -n BATCH  tokens per batch (default %d)\n", DEFAULT_BATCH);
+    fprintf(stderr, "  -b        benchmark FILE over batch sizes on 1 and 2 threads\n");
+    fprintf(stderr, "  -g MB     write about MB megabytes of random expressions to FILE\n");
+    fprintf(stderr, "Without -f the program runs interactively.\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *file = NULL;
+    int threads = 2;
+    long batch_size = DEFAULT_BATCH;
+    bool bench = false;
+    int generate_mb = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            file = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            batch_size = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            generate_mb = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if ((bench || generate_mb > 0) && !file) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (generate_mb > 0) return generate_expressions(file, generate_mb);
+    if (bench) return benchmark_batches(file, 3);
+    if (file) return parse_file(file, threads, batch_size > 0 ? (size_t)batch_size : DEFAULT_BATCH);
+
     printf("=== Fixed Bottom-Up Operator Precedence Parser ===\n");
     printf("===================================================\n\n");
 
@@ -0,0 +1,1448 @@
+/*
+ * scangen: a direct-coded scanner generator for the .l files of this repo.
+ *
+ *   gcc -O2 -o scangen scangen.c
+ *   ./scangen [-o OUT.c] [-s] SCANNER.l
+ *
+ * It reads the definitions and rules sections of a flex input, builds a
+ * Thompson NFA for the rules, turns it into a DFA by subset construction
+ * over byte equivalence classes, minimizes that with Hopcroft's
+ * algorithm and writes the DFA out as C with one label per state and a
+ * switch per state, as re2c does, instead of flex's table interpreter.
+ *
+ * Matching follows flex: the longest match wins, the earliest rule wins
+ * a tie, and a byte no rule matches is echoed. The generated file offers
+ * the flex interface the .l files use (yytext, yyleng, yyin, yyout,
+ * yylex, yywrap, yyrestart, yy_scan_buffer, yy_delete_buffer, YY_INPUT,
+ * YY_BUF_SIZE, and with %option reentrant the yylex_init_extra family),
+ * so section 1 and section 3 code compiles unchanged. Start conditions,
+ * trailing context, anchors, REJECT, yymore and unput are not supported.
+ *
+ * -s prints the NFA, DFA and minimized DFA sizes to stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#define MAX_DEFS 256
+#define MAX_RULES 512
+#define MAX_CODE_BLOCKS 64
+
+typedef struct {
+    uint64_t bits[4];
+} ByteSet;
+
+typedef struct {
+    char *name;
+    char *regex;
+} Definition;
+
+typedef struct {
+    char *pattern;
+    char *action;
+    int line;
+} Rule;
+
+typedef struct {
+    char *text;
+    int line;
+} CodeBlock;
+
+/* What the .l file says, split into its parts. */
+typedef struct {
+    const char *path;
+    Definition defs[MAX_DEFS];
+    int def_count;
+    Rule rules[MAX_RULES];
+    int rule_count;
+    CodeBlock code[MAX_CODE_BLOCKS];   /* section 1 %{ %} blocks */
+    int code_count;
+    CodeBlock rules_code;              /* %{ %} at the top of section 2 */
+    CodeBlock user_code;               /* section 3 */
+    bool reentrant;
+    bool noyywrap;
+    char *extra_type;
+} Spec;
+
+/*
+ * Thompson NFA: every state has at most two epsilon edges, or one edge
+ * on a byte set, and may accept a rule.
+ */
+typedef struct {
+    int eps[2];
+    int set;      /* index into sets, or -1 */
+    int target;
+    int accept;   /* rule index, or -1 */
+} NfaState;
+
+typedef struct {
+    NfaState *states;
+    int count, cap;
+    ByteSet *sets;
+    int set_count, set_cap;
+} Nfa;
+
+typedef struct {
+    int start, end;
+} Fragment;
+
+typedef struct {
+    int class_count;
+    uint8_t byte_class[256];
+    int state_count;
+    int *next;       /* state_count * class_count, -1 = no transition */
+    int *accept;     /* rule index, or -1 */
+} Dfa;
+
+static void fatal(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "scangen: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    exit(1);
+}
+
+static void *xmalloc(size_t size) {
+    void *p = malloc(size ? size : 1);
+    if (!p) fatal("out of memory");
+    return p;
+}
+
+static void *xrealloc(void *p, size_t size) {
+    p = realloc(p, size ? size : 1);
+    if (!p) fatal("out of memory");
+    return p;
+}
+
+static char *xstrndup(const char *s, size_t n) {
+    char *copy = xmalloc(n + 1);
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+static char *read_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) fatal("cannot open %s", path);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = xmalloc((size_t)size + 1);
+    if (fread(text, 1, (size_t)size, file) != (size_t)size) fatal("cannot read %s", path);
+    text[size] = '\0';
+    fclose(file);
+    return text;
+}
+
+/* ---------------------------------------------------------------- */
+/* Reading the .l file                                               */
+/* ---------------------------------------------------------------- */
+
+/* Line reader over the whole file; line numbers start at 1. */
+typedef struct {
+    char *text;
+    char *pos;
+    int line;
+} Reader;
+
+static bool next_line(Reader *r, char **start, size_t *len) {
+    if (*r->pos == '\0') return false;
+    *start = r->pos;
+    char *end = strchr(r->pos, '\n');
+    if (!end) end = r->pos + strlen(r->pos);
+    *len = (size_t)(end - r->pos);
+    if (*len > 0 && (*start)[*len - 1] == '\r') (*len)--;
+    r->pos = *end ? end + 1 : end;
+    r->line++;
+    return true;
+}
+
+static bool ends_comment(const char *line, size_t len) {
+    for (size_t i = 0; i + 1 < len; i++) {
+        if (line[i] == '*' && line[i + 1] == '/') return true;
+    }
+    return false;
+}
+
+static bool line_is(const char *line, size_t len, const char *word) {
+    size_t n = strlen(word);
+    if (len < n || strncmp(line, word, n) != 0) return false;
+    for (size_t i = n; i < len; i++) {
+        if (!isspace((unsigned char)line[i])) return false;
+    }
+    return true;
+}
+
+/* Collects the lines up to a "%}" line into one block. */
+static char *read_code_block(Reader *r) {
+    char *line, *begin = r->pos;
+    size_t len;
+    while (next_line(r, &line, &len)) {
+        if (line_is(line, len, "%}")) return xstrndup(begin, (size_t)(line - begin));
+    }
+    fatal("unterminated %%{ block");
+    return NULL;
+}
+
+static void parse_options(Spec *spec, const char *line, size_t len) {
+    char *text = xstrndup(line, len);
+    char *p = text + strlen("%option");
+
+    for (;;) {
+        while (isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+        char *word = p;
+        while (*p && !isspace((unsigned char)*p)) {
+            if (*p == '"') {
+                p = strchr(p + 1, '"');
+                if (!p) fatal("unterminated string in %%option");
+            }
+            p++;
+        }
+        if (*p) *p++ = '\0';
+
+        if (strcmp(word, "reentrant") == 0) {
+            spec->reentrant = true;
+        } else if (strcmp(word, "noyywrap") == 0) {
+            spec->noyywrap = true;
+        } else if (strncmp(word, "extra-type=\"", 12) == 0) {
+            spec->extra_type = xstrndup(word + 12, strlen(word) - 13);
+        } else if (strcmp(word, "nounput") != 0 && strcmp(word, "noinput") != 0 &&
+                   strcmp(word, "never-interactive") != 0 && strcmp(word, "8bit") != 0) {
+            fprintf(stderr, "scangen: ignoring %%option %s\n", word);
+        }
+    }
+    free(text);
+}
+
+static void parse_definitions(Spec *spec, Reader *r) {
+    char *line;
+    size_t len;
+    bool in_comment = false;
+
+    while (next_line(r, &line, &len)) {
+        if (line_is(line, len, "%%")) return;
+        if (in_comment) {
+            if (ends_comment(line, len)) in_comment = false;
+            continue;
+        }
+        if (len == 0) continue;
+        if (line_is(line, len, "%{")) {
+            if (spec->code_count == MAX_CODE_BLOCKS) fatal("too many %%{ blocks");
+            spec->code[spec->code_count].line = r->line + 1;
+            spec->code[spec->code_count++].text = read_code_block(r);
+        } else if (strncmp(line, "%option", 7) == 0) {
+            parse_options(spec, line, len);
+        } else if (line[0] == '%') {
+            fatal("%s:%d: unsupported directive", spec->path, r->line);
+        } else if (len >= 2 && line[0] == '/' && line[1] == '*') {
+            in_comment = !ends_comment(line + 2, len - 2);
+        } else if (isspace((unsigned char)line[0])) {
+            bool blank = true;
+            for (size_t i = 0; i < len; i++) blank = blank && isspace((unsigned char)line[i]);
+            if (!blank) fatal("%s:%d: indented code in definitions is not supported", spec->path, r->line);
+        } else {
+            size_t n = 0;
+            while (n < len && (isalnum((unsigned char)line[n]) || line[n] == '_' || line[n] == '-')) n++;
+            if (n == 0) fatal("%s:%d: bad definition", spec->path, r->line);
+            size_t start = n;
+            while (start < len && isspace((unsigned char)line[start])) start++;
+            size_t end = len;
+            while (end > start && isspace((unsigned char)line[end - 1])) end--;
+            if (spec->def_count == MAX_DEFS) fatal("too many definitions");
+            spec->defs[spec->def_count].name = xstrndup(line, n);
+            spec->defs[spec->def_count++].regex = xstrndup(line + start, end - start);
+        }
+    }
+    fatal("%s: missing %%%%", spec->path);
+}
+
+/* Length of the pattern at p: up to the first unquoted, unbracketed blank. */
+static size_t pattern_length(const char *p) {
+    size_t i = 0;
+    bool quoted = false;
+    int bracket = 0;
+
+    while (p[i] && p[i] != '\n') {
+        char c = p[i];
+        if (c == '\\' && p[i + 1]) {
+            i += 2;
+            continue;
+        }
+        if (quoted) {
+            if (c == '"') quoted = false;
+        } else if (bracket) {
+            if (c == ']' && bracket > 1) bracket = 0;
+            else bracket++;
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == '[') {
+            bracket = 1;
+            if (p[i + 1] == '^') i++;
+            if (p[i + 1] == ']') i++;   /* a leading ] is literal */
+        } else if (c == ' ' || c == '\t') {
+            break;
+        }
+        i++;
+    }
+    return i;
+}
+
+/* Length of a braced action at p, skipping strings, characters and comments. */
+static size_t action_length(const char *p, const Spec *spec, int line) {
+    int depth = 0;
+    size_t i = 0;
+
+    for (;;) {
+        char c = p[i];
+        if (c == '\0') fatal("%s:%d: unterminated action", spec->path, line);
+        if (c == '"' || c == '\'') {
+            for (i++; p[i] && p[i] != c; i++) {
+                if (p[i] == '\\' && p[i + 1]) i++;
+            }
+        } else if (c == '/' && p[i + 1] == '*') {
+            char *end = strstr(p + i + 2, "*/");
+            if (!end) fatal("%s:%d: unterminated comment", spec->path, line);
+            i = (size_t)(end - p) + 1;
+        } else if (c == '/' && p[i + 1] == '/') {
+            while (p[i + 1] && p[i + 1] != '\n') i++;
+        } else if (c == '{') {
+            depth++;
+        } else if (c == '}') {
+            if (--depth == 0) return i + 1;
+        }
+        i++;
+    }
+}
+
+static int count_newlines(const char *p, size_t len) {
+    int n = 0;
+    for (size_t i = 0; i < len; i++) n += p[i] == '\n';
+    return n;
+}
+
+static void parse_rules(Spec *spec, Reader *r) {
+    bool pending_or = false;
+
+    while (*r->pos) {
+        char *p = r->pos;
+        int line = r->line + 1;
+
+        if (strncmp(p, "%%", 2) == 0 && (p[2] == '\n' || p[2] == '\0' || p[2] == '\r')) {
+            char *rest;
+            size_t len;
+            next_line(r, &rest, &len);
+            spec->user_code.line = r->line + 1;
+            spec->user_code.text = r->pos;
+            return;
+        }
+        if (strncmp(p, "%{", 2) == 0) {
+            char *rest;
+            size_t len;
+            next_line(r, &rest, &len);
+            if (spec->rule_count > 0) fatal("%s:%d: %%{ after the first rule", spec->path, line);
+            spec->rules_code.line = r->line + 1;
+            spec->rules_code.text = read_code_block(r);
+            continue;
+        }
+        if (*p == '\n' || *p == '\r' || *p == ' ' || *p == '\t') {
+            char *rest;
+            size_t len;
+            next_line(r, &rest, &len);
+            for (size_t i = 0; i < len; i++) {
+                if (!isspace((unsigned char)rest[i])) fatal("%s:%d: indented code in rules is not supported", spec->path, line);
+            }
+            continue;
+        }
+
+        size_t plen = pattern_length(p);
+        if (spec->rule_count == MAX_RULES) fatal("too many rules");
+        Rule *rule = &spec->rules[spec->rule_count++];
+        rule->pattern = xstrndup(p, plen);
+        rule->line = line;
+
+        char *a = p + plen;
+        while (*a == ' ' || *a == '\t') a++;
+        size_t alen;
+        if (*a == '{') {
+            alen = action_length(a, spec, line);
+        } else {
+            alen = strcspn(a, "\n");
+            while (alen > 0 && isspace((unsigned char)a[alen - 1])) alen--;
+        }
+        rule->action = xstrndup(a, alen);
+
+        /* a "|" action shares the next rule's action */
+        if (pending_or) spec->rules[spec->rule_count - 2].action = NULL;
+        pending_or = strcmp(rule->action, "|") == 0;
+
+        r->line += count_newlines(p, (size_t)(a + alen - p));
+        r->pos = a + alen;
+        r->pos += strcspn(r->pos, "\n");
+        if (*r->pos == '\n') {
+            r->pos++;
+            r->line++;
+        }
+    }
+    spec->user_code.text = r->pos;
+    spec->user_code.line = r->line + 1;
+}
+
+static void parse_spec(Spec *spec, const char *path) {
+    Reader r = { read_file(path), NULL, 0 };
+    r.pos = r.text;
+    memset(spec, 0, sizeof(*spec));
+    spec->path = path;
+    parse_definitions(spec, &r);
+    parse_rules(spec, &r);
+    if (spec->rule_count == 0) fatal("%s: no rules", path);
+
+    /* resolve "|" chains: each takes the action of the next real one */
+    for (int i = spec->rule_count - 1; i >= 0; i--) {
+        if (strcmp(spec->rules[i].action, "|") == 0) {
+            if (i == spec->rule_count - 1) fatal("%s:%d: last rule has action |", path, spec->rules[i].line);
+            spec->rules[i].action = spec->rules[i + 1].action;
+            spec->rules[i].line = spec->rules[i + 1].line;
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* Regular expressions to a Thompson NFA                             */
+/* ---------------------------------------------------------------- */
+
+static void set_add(ByteSet *s, int c) {
+    s->bits[c >> 6] |= 1ULL << (c & 63);
+}
+
+static bool set_has(const ByteSet *s, int c) {
+    return (s->bits[c >> 6] >> (c & 63)) & 1;
+}
+
+static int nfa_state(Nfa *nfa) {
+    if (nfa->count == nfa->cap) {
+        nfa->cap = nfa->cap ? nfa->cap * 2 : 256;
+        nfa->states = xrealloc(nfa->states, (size_t)nfa->cap * sizeof(NfaState));
+    }
+    NfaState *s = &nfa->states[nfa->count];
+    s->eps[0] = s->eps[1] = -1;
+    s->set = -1;
+    s->target = -1;
+    s->accept = -1;
+    return nfa->count++;
+}
+
+static void nfa_eps(Nfa *nfa, int from, int to) {
+    NfaState *s = &nfa->states[from];
+    if (s->eps[0] < 0) {
+        s->eps[0] = to;
+    } else if (s->eps[1] < 0) {
+        s->eps[1] = to;
+    } else {
+        /* a third edge goes through a new state */
+        int mid = nfa_state(nfa);
+        nfa->states[mid].eps[0] = nfa->states[from].eps[1];
+        nfa->states[mid].eps[1] = to;
+        nfa->states[from].eps[1] = mid;
+    }
+}
+
+static Fragment nfa_set(Nfa *nfa, const ByteSet *set) {
+    if (nfa->set_count == nfa->set_cap) {
+        nfa->set_cap = nfa->set_cap ? nfa->set_cap * 2 : 64;
+        nfa->sets = xrealloc(nfa->sets, (size_t)nfa->set_cap * sizeof(ByteSet));
+    }
+    nfa->sets[nfa->set_count] = *set;
+    Fragment f = { nfa_state(nfa), nfa_state(nfa) };
+    nfa->states[f.start].set = nfa->set_count++;
+    nfa->states[f.start].target = f.end;
+    return f;
+}
+
+static Fragment nfa_empty(Nfa *nfa) {
+    Fragment f = { nfa_state(nfa), nfa_state(nfa) };
+    nfa_eps(nfa, f.start, f.end);
+    return f;
+}
+
+static Fragment nfa_concat(Nfa *nfa, Fragment a, Fragment b) {
+    nfa_eps(nfa, a.end, b.start);
+    return (Fragment){ a.start, b.end };
+}
+
+static Fragment nfa_alt(Nfa *nfa, Fragment a, Fragment b) {
+    Fragment f = { nfa_state(nfa), nfa_state(nfa) };
+    nfa_eps(nfa, f.start, a.start);
+    nfa_eps(nfa, f.start, b.start);
+    nfa_eps(nfa, a.end, f.end);
+    nfa_eps(nfa, b.end, f.end);
+    return f;
+}
+
+static Fragment nfa_star(Nfa *nfa, Fragment a) {
+    Fragment f = { nfa_state(nfa), nfa_state(nfa) };
+    nfa_eps(nfa, f.start, a.start);
+    nfa_eps(nfa, f.start, f.end);
+    nfa_eps(nfa, a.end, a.start);
+    nfa_eps(nfa, a.end, f.end);
+    return f;
+}
+
+static Fragment nfa_optional(Nfa *nfa, Fragment a) {
+    Fragment f = { nfa_state(nfa), nfa_state(nfa) };
+    nfa_eps(nfa, f.start, a.start);
+    nfa_eps(nfa, f.start, f.end);
+    nfa_eps(nfa, a.end, f.end);
+    return f;
+}
+
+/* Recursive-descent parser over one regex string. */
+typedef struct {
+    const Spec *spec;
+    Nfa *nfa;
+    const char *text;
+    const char *p;
+    int line;
+    int depth;       /* nesting of {name} expansions */
+} RegexParser;
+
+static Fragment parse_alt(RegexParser *rp);
+
+static void regex_error(RegexParser *rp, const char *what) {
+    fatal("%s:%d: %s in \"%s\"", rp->spec->path, rp->line, what, rp->text);
+}
+
+static int parse_escape(RegexParser *rp) {
+    char c = *rp->p++;
+    switch (c) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    case 'a': return '\a';
+    case 'b': return '\b';
+    case 'x': {
+        int value = 0, digits = 0;
+        while (digits < 2 && isxdigit((unsigned char)*rp->p)) {
+            char d = *rp->p++;
+            value = value * 16 + (isdigit((unsigned char)d) ? d - '0' : tolower((unsigned char)d) - 'a' + 10);
+            digits++;
+        }
+        if (digits == 0) regex_error(rp, "bad \\x escape");
+        return value;
+    }
+    case '\0':
+        regex_error(rp, "trailing backslash");
+        return 0;
+    default:
+        if (c >= '0' && c <= '7') {
+            int value = c - '0';
+            for (int digits = 1; digits < 3 && *rp->p >= '0' && *rp->p <= '7'; digits++) {
+                value = value * 8 + (*rp->p++ - '0');
+            }
+            return value & 0xFF;
+        }
+        return (unsigned char)c;
+    }
+}
+
+static int class_char(RegexParser *rp) {
+    if (*rp->p == '\\') {
+        rp->p++;
+        return parse_escape(rp);
+    }
+    if (*rp->p == '\0') regex_error(rp, "unterminated character class");
+    return (unsigned char)*rp->p++;
+}
+
+static Fragment parse_class(RegexParser *rp) {
+    ByteSet set = { { 0 } };
+    bool negate = false;
+
+    if (*rp->p == '^') {
+        negate = true;
+        rp->p++;
+    }
+    bool first = true;
+    while (first || *rp->p != ']') {
+        if (*rp->p == '[' && rp->p[1] == ':') regex_error(rp, "character class expressions are not supported");
+        int lo = class_char(rp);
+        int hi = lo;
+        if (*rp->p == '-' && rp->p[1] != ']' && rp->p[1] != '\0') {
+            rp->p++;
+            hi = class_char(rp);
+            if (hi < lo) regex_error(rp, "reversed range");
+        }
+        for (int c = lo; c <= hi; c++) set_add(&set, c);
+        first = false;
+    }
+    rp->p++;
+    if (negate) {
+        for (int i = 0; i < 4; i++) set.bits[i] = ~set.bits[i];
+    }
+    return nfa_set(rp->nfa, &set);
+}
+
+static Fragment parse_string(RegexParser *rp) {
+    Fragment f = nfa_empty(rp->nfa);
+    while (*rp->p != '"') {
+        if (*rp->p == '\0') regex_error(rp, "unterminated string");
+        int c = *rp->p == '\\' ? (rp->p++, parse_escape(rp)) : (unsigned char)*rp->p++;
+        ByteSet set = { { 0 } };
+        set_add(&set, c);
+        f = nfa_concat(rp->nfa, f, nfa_set(rp->nfa, &set));
+    }
+    rp->p++;
+    return f;
+}
+
+static Fragment parse_definition_ref(RegexParser *rp) {
+    const char *end = strchr(rp->p, '}');
+    if (!end) regex_error(rp, "unterminated {name}");
+    size_t len = (size_t)(end - rp->p);
+
+    for (int i = 0; i < rp->spec->def_count; i++) {
+        const Definition *d = &rp->spec->defs[i];
+        if (strlen(d->name) == len && strncmp(d->name, rp->p, len) == 0) {
+            if (rp->depth > 32) regex_error(rp, "definitions nest too deeply");
+            RegexParser sub = { rp->spec, rp->nfa, d->regex, d->regex, rp->line, rp->depth + 1 };
+            Fragment f = parse_alt(&sub);
+            if (*sub.p != '\0') regex_error(&sub, "unexpected character");
+            rp->p = end + 1;
+            return f;
+        }
+    }
+    regex_error(rp, "undefined {name}");
+    return (Fragment){ 0, 0 };
+}
+
+static Fragment parse_atom(RegexParser *rp) {
+    char c = *rp->p++;
+    ByteSet set = { { 0 } };
+
+    switch (c) {
+    case '(': {
+        Fragment f = parse_alt(rp);
+        if (*rp->p != ')') regex_error(rp, "missing )");
+        rp->p++;
+        return f;
+    }
+    case '[':
+        return parse_class(rp);
+    case '"':
+        return parse_string(rp);
+    case '{':
+        return parse_definition_ref(rp);
+    case '.':
+        for (int b = 0; b < 256; b++) {
+            if (b != '\n') set_add(&set, b);
+        }
+        return nfa_set(rp->nfa, &set);
+    case '\\':
+        set_add(&set, parse_escape(rp));
+        return nfa_set(rp->nfa, &set);
+    case '^':
+    case '$':
+    case '/':
+        regex_error(rp, "anchors and trailing context are not supported");
+        break;
+    case ')':
+    case '|':
+    case '*':
+    case '+':
+    case '?':
+    case '\0':
+        rp->p--;
+        regex_error(rp, "unexpected character");
+        break;
+    default:
+        break;
+    }
+    set_add(&set, (unsigned char)c);
+    return nfa_set(rp->nfa, &set);
+}
+
+/* A fresh copy of the atom whose text starts at start. */
+static Fragment copy_atom(RegexParser *rp, const char *start) {
+    RegexParser again = *rp;
+    again.p = start;
+    return parse_atom(&again);
+}
+
+/* An atom with its postfix operators; + and {n,m} re-parse the atom's text. */
+static Fragment parse_repeat(RegexParser *rp) {
+    const char *atom_start = rp->p;
+    Fragment f = parse_atom(rp);
+
+    for (;;) {
+        if (*rp->p == '*') {
+            rp->p++;
+            f = nfa_star(rp->nfa, f);
+        } else if (*rp->p == '?') {
+            rp->p++;
+            f = nfa_optional(rp->nfa, f);
+        } else if (*rp->p == '+') {
+            rp->p++;
+            if (!atom_start) regex_error(rp, "+ after another repeat");
+            f = nfa_concat(rp->nfa, f, nfa_star(rp->nfa, copy_atom(rp, atom_start)));
+        } else if (*rp->p == '{' && isdigit((unsigned char)rp->p[1])) {
+            char *end;
+            long lo = strtol(rp->p + 1, &end, 10), hi = lo;
+            if (*end == ',') {
+                end++;
+                hi = isdigit((unsigned char)*end) ? strtol(end, &end, 10) : -1;
+            }
+            if (*end != '}' || (hi >= 0 && hi < lo) || lo > 255 || hi > 255) regex_error(rp, "bad repeat count");
+            if (!atom_start) regex_error(rp, "repeat count after another repeat");
+            rp->p = end + 1;
+            /* lo copies, then hi - lo optional ones or a starred one */
+            Fragment result = nfa_empty(rp->nfa);
+            long copies = hi < 0 ? lo + 1 : hi;
+            for (long i = 0; i < copies; i++) {
+                Fragment copy = i == 0 ? f : copy_atom(rp, atom_start);
+                if (i >= lo) copy = hi < 0 ? nfa_star(rp->nfa, copy) : nfa_optional(rp->nfa, copy);
+                result = nfa_concat(rp->nfa, result, copy);
+            }
+            f = result;
+        } else {
+            break;
+        }
+        atom_start = NULL;
+    }
+    return f;
+}
+
+static Fragment parse_concat(RegexParser *rp) {
+    Fragment f = nfa_empty(rp->nfa);
+    while (*rp->p && *rp->p != '|' && *rp->p != ')') {
+        f = nfa_concat(rp->nfa, f, parse_repeat(rp));
+    }
+    return f;
+}
+
+static Fragment parse_alt(RegexParser *rp) {
+    Fragment f = parse_concat(rp);
+    while (*rp->p == '|') {
+        rp->p++;
+        f = nfa_alt(rp->nfa, f, parse_concat(rp));
+    }
+    return f;
+}
+
+/* One NFA for all rules: state 0 has an epsilon edge to each rule. */
+static void build_nfa(const Spec *spec, Nfa *nfa) {
+    int start = nfa_state(nfa);
+    for (int i = 0; i < spec->rule_count; i++) {
+        RegexParser rp = { spec, nfa, spec->rules[i].pattern, spec->rules[i].pattern, spec->rules[i].line, 0 };
+        Fragment f = parse_alt(&rp);
+        if (*rp.p != '\0') regex_error(&rp, "unexpected character");
+        nfa->states[f.end].accept = i;
+        nfa_eps(nfa, start, f.start);
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* Subset construction                                               */
+/* ---------------------------------------------------------------- */
+
+/*
+ * Bytes that every byte set of the NFA treats alike share a class. NUL
+ * always gets a class of its own because the generated code uses it as
+ * the end-of-buffer sentinel.
+ */
+static void compute_classes(const Nfa *nfa, Dfa *dfa) {
+    int reps[256];
+    dfa->class_count = 0;
+    for (int b = 0; b < 256; b++) {
+        int cls = -1;
+        for (int k = b == 0 ? dfa->class_count : 0; k < dfa->class_count && cls < 0; k++) {
+            int r = reps[k];
+            if (r == 0) continue;
+            bool same = true;
+            for (int s = 0; s < nfa->set_count && same; s++) {
+                same = set_has(&nfa->sets[s], b) == set_has(&nfa->sets[s], r);
+            }
+            if (same) cls = k;
+        }
+        if (cls < 0) {
+            cls = dfa->class_count++;
+            reps[cls] = b;
+        }
+        dfa->byte_class[b] = (uint8_t)cls;
+    }
+}
+
+typedef struct {
+    int *items;
+    int len;
+} StateSet;
+
+typedef struct {
+    StateSet *sets;
+    int count, cap;
+    int *table;        /* open addressing over sets, -1 = empty */
+    int table_cap;
+} SetIndex;
+
+static uint64_t hash_set(const int *items, int len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (int i = 0; i < len; i++) {
+        h ^= (uint64_t)items[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void index_grow(SetIndex *ix) {
+    int cap = ix->table_cap ? ix->table_cap * 2 : 1024;
+    int *table = xmalloc((size_t)cap * sizeof(int));
+    for (int i = 0; i < cap; i++) table[i] = -1;
+    for (int k = 0; k < ix->count; k++) {
+        uint64_t h = hash_set(ix->sets[k].items, ix->sets[k].len);
+        int slot = (int)(h & (uint64_t)(cap - 1));
+        while (table[slot] >= 0) slot = (slot + 1) & (cap - 1);
+        table[slot] = k;
+    }
+    free(ix->table);
+    ix->table = table;
+    ix->table_cap = cap;
+}
+
+/* Returns the index of the set, adding it if new; *added tells which. */
+static int index_find(SetIndex *ix, const int *items, int len, bool *added) {
+    if (2 * (ix->count + 1) > ix->table_cap) index_grow(ix);
+    uint64_t h = hash_set(items, len);
+    int slot = (int)(h & (uint64_t)(ix->table_cap - 1));
+    while (ix->table[slot] >= 0) {
+        StateSet *s = &ix->sets[ix->table[slot]];
+        if (s->len == len && memcmp(s->items, items, (size_t)len * sizeof(int)) == 0) {
+            *added = false;
+            return ix->table[slot];
+        }
+        slot = (slot + 1) & (ix->table_cap - 1);
+    }
+    if (ix->count == ix->cap) {
+        ix->cap = ix->cap ? ix->cap * 2 : 256;
+        ix->sets = xrealloc(ix->sets, (size_t)ix->cap * sizeof(StateSet));
+    }
+    ix->sets[ix->count].items = xmalloc((size_t)len * sizeof(int));
+    memcpy(ix->sets[ix->count].items, items, (size_t)len * sizeof(int));
+    ix->sets[ix->count].len = len;
+    ix->table[slot] = ix->count;
+    *added = true;
+    return ix->count++;
+}
+
+static int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/* Epsilon closure of items[0..len) in place; returns the new length. */
+static int closure(const Nfa *nfa, int *items, int len, int *stack, int *mark, int stamp) {
+    int top = 0;
+    for (int i = 0; i < len; i++) {
+        mark[items[i]] = stamp;
+        stack[top++] = items[i];
+    }
+    while (top > 0) {
+        int s = stack[--top];
+        for (int e = 0; e < 2; e++) {
+            int t = nfa->states[s].eps[e];
+            if (t >= 0 && mark[t] != stamp) {
+                mark[t] = stamp;
+                items[len++] = t;
+                stack[top++] = t;
+            }
+        }
+    }
+    qsort(items, (size_t)len, sizeof(int), compare_ints);
+    return len;
+}
+
+static void build_dfa(const Nfa *nfa, Dfa *dfa) {
+    SetIndex ix = { 0 };
+    int *items = xmalloc((size_t)nfa->count * sizeof(int));
+    int *stack = xmalloc((size_t)nfa->count * sizeof(int));
+    int *mark = xmalloc((size_t)nfa->count * sizeof(int));
+    int reps[256], stamp = 0, next_cap = 0;
+    bool added;
+
+    for (int i = 0; i < nfa->count; i++) mark[i] = -1;
+    for (int b = 255; b >= 0; b--) reps[dfa->byte_class[b]] = b;
+
+    items[0] = 0;
+    int len = closure(nfa, items, 1, stack, mark, stamp++);
+    index_find(&ix, items, len, &added);
+    dfa->next = NULL;
+
+    for (int d = 0; d < ix.count; d++) {
+        if ((d + 1) * dfa->class_count > next_cap) {
+            next_cap = next_cap ? next_cap * 2 : 1024 * dfa->class_count;
+            dfa->next = xrealloc(dfa->next, (size_t)next_cap * sizeof(int));
+        }
+        for (int c = 0; c < dfa->class_count; c++) {
+            const StateSet *set = &ix.sets[d];
+            len = 0;
+            for (int i = 0; i < set->len; i++) {
+                const NfaState *s = &nfa->states[set->items[i]];
+                if (s->set >= 0 && set_has(&nfa->sets[s->set], reps[c])) items[len++] = s->target;
+            }
+            if (len == 0) {
+                dfa->next[d * dfa->class_count + c] = -1;
+                continue;
+            }
+            /* drop duplicates before the closure marks them */
+            qsort(items, (size_t)len, sizeof(int), compare_ints);
+            int unique = 0;
+            for (int i = 0; i < len; i++) {
+                if (i == 0 || items[i] != items[i - 1]) items[unique++] = items[i];
+            }
+            len = closure(nfa, items, unique, stack, mark, stamp++);
+            dfa->next[d * dfa->class_count + c] = index_find(&ix, items, len, &added);
+        }
+    }
+
+    dfa->state_count = ix.count;
+    dfa->accept = xmalloc((size_t)ix.count * sizeof(int));
+    for (int d = 0; d < ix.count; d++) {
+        int best = -1;
+        for (int i = 0; i < ix.sets[d].len; i++) {
+            int a = nfa->states[ix.sets[d].items[i]].accept;
+            if (a >= 0 && (best < 0 || a < best)) best = a;
+        }
+        dfa->accept[d] = best;
+        free(ix.sets[d].items);
+    }
+    free(ix.sets);
+    free(ix.table);
+    free(items);
+    free(stack);
+    free(mark);
+}
+
+/* ---------------------------------------------------------------- */
+/* Hopcroft minimization                                             */
+/* ---------------------------------------------------------------- */
+
+/*
+ * States are kept in one array ordered by block, so a block is a range
+ * [first, first + size) and splitting it moves the marked states to its
+ * front. A dead state n makes the automaton complete; states that end
+ * up in its block cannot reach an accepting state and are dropped.
+ */
+static void minimize_dfa(const Dfa *dfa, Dfa *min) {
+    int n = dfa->state_count + 1, dead = dfa->state_count, k = dfa->class_count;
+    int *delta = xmalloc((size_t)n * (size_t)k * sizeof(int));
+    int *elems = xmalloc((size_t)n * sizeof(int));
+    int *loc = xmalloc((size_t)n * sizeof(int));
+    int *block_of = xmalloc((size_t)n * sizeof(int));
+    int *first = xmalloc((size_t)n * sizeof(int));
+    int *size = xmalloc((size_t)n * sizeof(int));
+    int *marked = xmalloc((size_t)n * sizeof(int));
+    bool *in_work = xmalloc((size_t)n * (size_t)k * sizeof(bool));
+    int *work = xmalloc((size_t)n * (size_t)k * 2 * sizeof(int));
+    int *touched = xmalloc((size_t)n * sizeof(int));
+    int blocks = 0, work_len = 0;
+
+    for (int s = 0; s < n; s++) {
+        for (int c = 0; c < k; c++) {
+            int t = s == dead ? dead : dfa->next[s * k + c];
+            delta[s * k + c] = t < 0 ? dead : t;
+        }
+    }
+
+    /* inverse transitions: for class c and target t, the sources */
+    int *inv_start = xmalloc(((size_t)n * (size_t)k + 1) * sizeof(int));
+    int *inv = xmalloc((size_t)n * (size_t)k * sizeof(int));
+    memset(inv_start, 0, ((size_t)n * (size_t)k + 1) * sizeof(int));
+    for (int s = 0; s < n; s++) {
+        for (int c = 0; c < k; c++) inv_start[delta[s * k + c] * k + c + 1]++;
+    }
+    for (int i = 0; i < n * k; i++) inv_start[i + 1] += inv_start[i];
+    int *fill = xmalloc((size_t)n * (size_t)k * sizeof(int));
+    memcpy(fill, inv_start, (size_t)n * (size_t)k * sizeof(int));
+    for (int s = 0; s < n; s++) {
+        for (int c = 0; c < k; c++) {
+            int t = delta[s * k + c];
+            inv[fill[t * k + c]++] = s;
+        }
+    }
+    free(fill);
+
+    /* initial partition: one block per accepted rule, one for the rest */
+    int max_accept = -1;
+    for (int s = 0; s < dfa->state_count; s++) {
+        if (dfa->accept[s] > max_accept) max_accept = dfa->accept[s];
+    }
+    int *block_for_accept = xmalloc((size_t)(max_accept + 2) * sizeof(int));
+    for (int a = 0; a < max_accept + 2; a++) block_for_accept[a] = -1;
+    for (int s = 0; s < n; s++) {
+        int a = s == dead ? -1 : dfa->accept[s];
+        if (block_for_accept[a + 1] < 0) {
+            block_for_accept[a + 1] = blocks;
+            size[blocks++] = 0;
+        }
+        block_of[s] = block_for_accept[a + 1];
+        size[block_of[s]]++;
+    }
+    free(block_for_accept);
+    for (int b = 0, pos = 0; b < blocks; b++) {
+        first[b] = pos;
+        pos += size[b];
+        size[b] = 0;
+    }
+    for (int s = 0; s < n; s++) {
+        int b = block_of[s];
+        elems[first[b] + size[b]] = s;
+        loc[s] = first[b] + size[b]++;
+    }
+    for (int b = 0; b < n; b++) marked[b] = 0;
+    memset(in_work, 0, (size_t)n * (size_t)k * sizeof(bool));
+    for (int b = 0; b < blocks; b++) {
+        for (int c = 0; c < k; c++) {
+            work[work_len++] = b;
+            work[work_len++] = c;
+            in_work[b * k + c] = true;
+        }
+    }
+
+    while (work_len > 0) {
+        int c = work[--work_len];
+        int a = work[--work_len];
+        in_work[a * k + c] = false;
+        int touched_count = 0;
+
+        /* mark every state with a c-transition into block a */
+        for (int i = first[a]; i < first[a] + size[a]; i++) {
+            int t = elems[i];
+            for (int j = inv_start[t * k + c]; j < inv_start[t * k + c + 1]; j++) {
+                int s = inv[j];
+                int b = block_of[s];
+                int pos = first[b] + marked[b];
+                if (loc[s] < pos) continue;   /* already marked */
+                if (marked[b] == 0) touched[touched_count++] = b;
+                int other = elems[pos];
+                elems[pos] = s;
+                elems[loc[s]] = other;
+                loc[other] = loc[s];
+                loc[s] = pos;
+                marked[b]++;
+            }
+        }
+
+        /* split every touched block whose states were not all marked */
+        for (int i = 0; i < touched_count; i++) {
+            int b = touched[i];
+            int m = marked[b];
+            marked[b] = 0;
+            if (m == size[b]) continue;
+            int nb = blocks++;
+            first[nb] = first[b];
+            size[nb] = m;
+            first[b] += m;
+            size[b] -= m;
+            for (int j = first[nb]; j < first[nb] + size[nb]; j++) block_of[elems[j]] = nb;
+            for (int cc = 0; cc < k; cc++) {
+                int add;
+                if (in_work[b * k + cc]) {
+                    add = nb;
+                } else {
+                    add = size[nb] <= size[b] ? nb : b;
+                }
+                if (!in_work[add * k + cc]) {
+                    in_work[add * k + cc] = true;
+                    work[work_len++] = add;
+                    work[work_len++] = cc;
+                }
+            }
+        }
+    }
+
+    /* number the live blocks in breadth-first order from the start */
+    int *number = xmalloc((size_t)blocks * sizeof(int));
+    int *order = xmalloc((size_t)blocks * sizeof(int));
+    for (int b = 0; b < blocks; b++) number[b] = -1;
+    int dead_block = block_of[dead], count = 0;
+    number[block_of[0]] = count;
+    order[count++] = block_of[0];
+    for (int head = 0; head < count; head++) {
+        int s = elems[first[order[head]]];
+        for (int c = 0; c < k; c++) {
+            int b = block_of[delta[s * k + c]];
+            if (b != dead_block && number[b] < 0) {
+                number[b] = count;
+                order[count++] = b;
+            }
+        }
+    }
+
+    min->class_count = k;
+    memcpy(min->byte_class, dfa->byte_class, sizeof(min->byte_class));
+    min->state_count = count;
+    min->next = xmalloc((size_t)count * (size_t)k * sizeof(int));
+    min->accept = xmalloc((size_t)count * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        int s = elems[first[order[i]]];
+        min->accept[i] = s == dead ? -1 : dfa->accept[s];
+        for (int c = 0; c < k; c++) {
+            int b = block_of[delta[s * k + c]];
+            min->next[i * k + c] = b == dead_block ? -1 : number[b];
+        }
+    }
+
+    free(number);
+    free(order);
+    free(delta);
+    free(elems);
+    free(loc);
+    free(block_of);
+    free(first);
+    free(size);
+    free(marked);
+    free(in_work);
+    free(work);
+    free(touched);
+    free(inv_start);
+    free(inv);
+}
+
+/* ---------------------------------------------------------------- */
+/* Code generation                                                   */
+/* ---------------------------------------------------------------- */
+
+typedef struct {
+    FILE *out;
+    const char *name;   /* output file name for #line */
+    int line;           /* current output line */
+} Emitter;
+
+static void emit(Emitter *e, const char *fmt, ...) {
+    char buf[4096];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= sizeof(buf)) fatal("emitted line too long");
+    fputs(buf, e->out);
+    e->line += count_newlines(buf, (size_t)n);
+}
+
+/* Copies code from the .l file under #line directives. */
+static void emit_code(Emitter *e, const Spec *spec, const char *text, int line) {
+    size_t len = strlen(text);
+    emit(e, "#line %d \"%s\"\n", line, spec->path);
+    fwrite(text, 1, len, e->out);
+    e->line += count_newlines(text, len);
+    if (len > 0 && text[len - 1] != '\n') {
+        fputc('\n', e->out);
+        e->line++;
+    }
+    emit(e, "#line %d \"%s\"\n", e->line + 1, e->name);
+}
+
+static void emit_runtime_head(Emitter *e, const Spec *spec) {
+    emit(e, "/* Generated by scangen from %s. Do not edit. */\n\n", spec->path);
+    emit(e, "#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n");
+    emit(e, "#ifdef _WIN32\n#include <io.h>\n#define isatty _isatty\n#define fileno _fileno\n#else\n#include <unistd.h>\n#endif\n\n");
+    emit(e, "#define YY_SCANGEN 1\n#define YY_NULL 0\n#define YY_END_OF_BUFFER_CHAR 0\n");
+    emit(e, "typedef size_t yy_size_t;\ntypedef struct yy_buffer_state *YY_BUFFER_STATE;\n\n");
+    emit(e, "static void yy_fatal_error(const char *msg) {\n    fprintf(stderr, \"%%s\\n\", msg);\n    exit(2);\n}\n");
+    emit(e, "#define YY_FATAL_ERROR(msg) yy_fatal_error(msg)\n");
+    emit(e, "#define ECHO ((void)fwrite(yytext, (size_t)yyleng, 1, yyout))\n");
+    emit(e, "#define yyterminate() return YY_NULL\n\n");
+
+    emit(e, "struct yy_buffer_state {\n");
+    emit(e, "    char *buf;\n    size_t cap;        /* bytes allocated, sentinel included */\n");
+    emit(e, "    char *limit;       /* end of the data; *limit is a NUL sentinel */\n");
+    emit(e, "    int ours;          /* buf was allocated here */\n");
+    emit(e, "    int fill;          /* more input can be read into buf */\n");
+    emit(e, "    int interactive;   /* read a line at a time */\n};\n\n");
+
+    if (spec->reentrant) {
+        emit(e, "#ifndef YY_EXTRA_TYPE\n#define YY_EXTRA_TYPE %s\n#endif\n", spec->extra_type ? spec->extra_type : "void *");
+        emit(e, "typedef void *yyscan_t;\n\n");
+        emit(e, "struct yyguts_t {\n    YY_BUFFER_STATE current;\n    char *cursor;\n    char hold;\n");
+        emit(e, "    FILE *yyin_r, *yyout_r;\n    char *yytext_r;\n    int yyleng_r;\n    YY_EXTRA_TYPE yyextra_r;\n};\n\n");
+        emit(e, "#define yyin (yyg->yyin_r)\n#define yyout (yyg->yyout_r)\n#define yytext (yyg->yytext_r)\n");
+        emit(e, "#define yyleng (yyg->yyleng_r)\n#define yyextra (yyg->yyextra_r)\n");
+        emit(e, "#define YYG_DECL struct yyguts_t *yyg = (struct yyguts_t *)yyscanner\n\n");
+        emit(e, "int yylex(yyscan_t yyscanner);\nint yylex_init(yyscan_t *scanner);\n");
+        emit(e, "int yylex_init_extra(YY_EXTRA_TYPE extra, yyscan_t *scanner);\nint yylex_destroy(yyscan_t yyscanner);\n");
+        emit(e, "void yyset_in(FILE *in, yyscan_t yyscanner);\nFILE *yyget_in(yyscan_t yyscanner);\n");
+        emit(e, "void yyset_out(FILE *out, yyscan_t yyscanner);\nFILE *yyget_out(yyscan_t yyscanner);\n");
+        emit(e, "YY_EXTRA_TYPE yyget_extra(yyscan_t yyscanner);\nvoid yyset_extra(YY_EXTRA_TYPE extra, yyscan_t yyscanner);\n");
+        emit(e, "char *yyget_text(yyscan_t yyscanner);\nint yyget_leng(yyscan_t yyscanner);\n");
+        emit(e, "void yyrestart(FILE *file, yyscan_t yyscanner);\n");
+        emit(e, "YY_BUFFER_STATE yy_scan_buffer(char *base, yy_size_t size, yyscan_t yyscanner);\n");
+        emit(e, "void yy_delete_buffer(YY_BUFFER_STATE b, yyscan_t yyscanner);\n");
+        if (spec->noyywrap) {
+            emit(e, "#define yywrap(scanner) 1\n\n");
+        } else {
+            emit(e, "int yywrap(yyscan_t yyscanner);\n\n");
+        }
+    } else {
+        emit(e, "struct yyguts_t {\n    YY_BUFFER_STATE current;\n    char *cursor;\n    char hold;\n};\n\n");
+        emit(e, "FILE *yyin, *yyout;\nchar *yytext;\nint yyleng;\n");
+        emit(e, "static struct yyguts_t yy_guts;\n");
+        emit(e, "#define YYG_DECL struct yyguts_t *yyg = &yy_guts\n\n");
+        emit(e, "int yylex(void);\nvoid yyrestart(FILE *file);\n");
+        emit(e, "YY_BUFFER_STATE yy_scan_buffer(char *base, yy_size_t size);\n");
+        emit(e, "void yy_delete_buffer(YY_BUFFER_STATE b);\n");
+        if (spec->noyywrap) {
+            emit(e, "#define yywrap() 1\n\n");
+        } else {
+            emit(e, "int yywrap(void);\n\n");
+        }
+    }
+}
+
+static void emit_runtime_defaults(Emitter *e) {
+    emit(e, "\n#ifndef YY_BUF_SIZE\n#define YY_BUF_SIZE 16384\n#endif\n");
+    emit(e, "#ifndef YY_READ_BUF_SIZE\n#define YY_READ_BUF_SIZE 8192\n#endif\n");
+    emit(e, "#ifndef YY_USER_ACTION\n#define YY_USER_ACTION\n#endif\n");
+    emit(e, "#ifndef YY_BREAK\n#define YY_BREAK break;\n#endif\n");
+    emit(e, "#ifndef YY_INPUT\n");
+    emit(e, "#define YY_INPUT(buf, result, max_size) \\\n");
+    emit(e, "    if (yyg->current->interactive) { \\\n");
+    emit(e, "        int c_ = '*', n_; \\\n");
+    emit(e, "        for (n_ = 0; n_ < (int)(max_size) && (c_ = getc(yyin)) != EOF && c_ != '\\n'; ++n_) (buf)[n_] = (char)c_; \\\n");
+    emit(e, "        if (c_ == '\\n') (buf)[n_++] = (char)c_; \\\n");
+    emit(e, "        if (c_ == EOF && ferror(yyin)) YY_FATAL_ERROR(\"input in scanner failed\"); \\\n");
+    emit(e, "        (result) = n_; \\\n");
+    emit(e, "    } else if (((result) = (int)fread((buf), 1, (size_t)(max_size), yyin)) == 0 && ferror(yyin)) \\\n");
+    emit(e, "        YY_FATAL_ERROR(\"input in scanner failed\");\n");
+    emit(e, "#endif\n\n");
+}
+
+static void emit_runtime_functions(Emitter *e, const Spec *spec) {
+    const char *param = spec->reentrant ? ", yyscan_t yyscanner" : "";
+
+    emit(e, "static YY_BUFFER_STATE yy_new_buffer(char *buf, size_t cap, size_t len, int ours) {\n");
+    emit(e, "    YY_BUFFER_STATE b = (YY_BUFFER_STATE)malloc(sizeof(*b));\n");
+    emit(e, "    if (!b) YY_FATAL_ERROR(\"out of dynamic memory in yy_new_buffer()\");\n");
+    emit(e, "    b->buf = buf;\n    b->cap = cap;\n    b->limit = buf + len;\n    *b->limit = YY_END_OF_BUFFER_CHAR;\n");
+    emit(e, "    b->ours = ours;\n    b->fill = ours;\n    b->interactive = 0;\n    return b;\n}\n\n");
+
+    emit(e, "static void yy_switch_to(struct yyguts_t *yyg, YY_BUFFER_STATE b) {\n");
+    emit(e, "    if (yyg->current && yyg->cursor) *yyg->cursor = yyg->hold;\n");
+    emit(e, "    yyg->current = b;\n    yyg->cursor = b->buf;\n    yyg->hold = *b->buf;\n}\n\n");
+
+    emit(e, "static void yy_file_buffer(struct yyguts_t *yyg, FILE *file) {\n");
+    emit(e, "    YY_BUFFER_STATE b = yyg->current;\n");
+    emit(e, "    if (!b || !b->ours) {\n");
+    emit(e, "        char *buf = (char *)malloc(YY_BUF_SIZE + 1);\n");
+    emit(e, "        if (!buf) YY_FATAL_ERROR(\"out of dynamic memory in yy_file_buffer()\");\n");
+    emit(e, "        b = yy_new_buffer(buf, YY_BUF_SIZE + 1, 0, 1);\n    }\n");
+    emit(e, "    b->limit = b->buf;\n    *b->limit = YY_END_OF_BUFFER_CHAR;\n    b->fill = 1;\n");
+    emit(e, "    b->interactive = file ? isatty(fileno(file)) > 0 : 0;\n");
+    emit(e, "    yyg->current = b;\n    yyg->cursor = b->buf;\n    yyg->hold = *b->buf;\n}\n\n");
+
+    emit(e, "void yyrestart(FILE *file%s) {\n    YYG_DECL;\n", param);
+    emit(e, "    if (yyg->current && yyg->cursor) *yyg->cursor = yyg->hold;\n");
+    emit(e, "    yyin = file;\n    yy_file_buffer(yyg, file);\n}\n\n");
+
+    emit(e, "YY_BUFFER_STATE yy_scan_buffer(char *base, yy_size_t size%s) {\n    YYG_DECL;\n", param);
+    emit(e, "    if (size < 2 || base[size - 2] != YY_END_OF_BUFFER_CHAR || base[size - 1] != YY_END_OF_BUFFER_CHAR) return NULL;\n");
+    emit(e, "    YY_BUFFER_STATE b = yy_new_buffer(base, size, size - 2, 0);\n");
+    emit(e, "    yy_switch_to(yyg, b);\n    return b;\n}\n\n");
+
+    emit(e, "void yy_delete_buffer(YY_BUFFER_STATE b%s) {\n    YYG_DECL;\n    if (!b) return;\n", param);
+    emit(e, "    if (b == yyg->current) {\n        *yyg->cursor = yyg->hold;\n        yyg->current = NULL;\n        yyg->cursor = NULL;\n    }\n");
+    emit(e, "    if (b->ours) free(b->buf);\n    free(b);\n}\n\n");
+
+    emit(e, "/*\n * Moves the token being matched to the front of the buffer, grows the\n");
+    emit(e, " * buffer if the token fills it, and reads more input after it. The\n");
+    emit(e, " * match pointers are moved along. Returns 0 at the end of the input.\n */\n");
+    emit(e, "static int yy_refill(struct yyguts_t *yyg, char **start, char **cursor, char **marker) {\n");
+    emit(e, "    YY_BUFFER_STATE b = yyg->current;\n");
+    emit(e, "    if (!b->fill) return 0;\n");
+    emit(e, "    size_t keep = (size_t)(b->limit - *start);\n");
+    emit(e, "    char *old = *start;\n");
+    emit(e, "    if (old != b->buf) memmove(b->buf, old, keep);\n");
+    emit(e, "    if (keep + 1 >= b->cap) {\n");
+    emit(e, "        char *grown = (char *)realloc(b->buf, b->cap * 2);\n");
+    emit(e, "        if (!grown) YY_FATAL_ERROR(\"out of dynamic memory in yy_refill()\");\n");
+    emit(e, "        b->buf = grown;\n        b->cap *= 2;\n    }\n");
+    emit(e, "    *cursor = b->buf + (*cursor - old);\n    *marker = b->buf + (*marker - old);\n    *start = b->buf;\n");
+    emit(e, "    size_t room = b->cap - keep - 1;\n");
+    emit(e, "    if (room > YY_READ_BUF_SIZE) room = YY_READ_BUF_SIZE;\n");
+    emit(e, "    int n = 0;\n");
+    emit(e, "    YY_INPUT((b->buf + keep), n, (int)room);\n");
+    emit(e, "    if (n <= 0) {\n        b->fill = 0;\n        n = 0;\n    }\n");
+    emit(e, "    b->limit = b->buf + keep + n;\n    *b->limit = YY_END_OF_BUFFER_CHAR;\n");
+    emit(e, "    return n > 0;\n}\n\n");
+
+    if (spec->reentrant) {
+        emit(e, "int yylex_init_extra(YY_EXTRA_TYPE extra, yyscan_t *scanner) {\n");
+        emit(e, "    struct yyguts_t *yyg = (struct yyguts_t *)calloc(1, sizeof(struct yyguts_t));\n");
+        emit(e, "    *scanner = yyg;\n    if (!yyg) return 1;\n    yyextra = extra;\n    return 0;\n}\n\n");
+        emit(e, "int yylex_init(yyscan_t *scanner) {\n    return yylex_init_extra((YY_EXTRA_TYPE)0, scanner);\n}\n\n");
+        emit(e, "int yylex_destroy(yyscan_t yyscanner) {\n    YYG_DECL;\n");
+        emit(e, "    if (yyg->current && yyg->current->ours) yy_delete_buffer(yyg->current, yyscanner);\n");
+        emit(e, "    free(yyg);\n    return 0;\n}\n\n");
+        emit(e, "void yyset_in(FILE *in, yyscan_t yyscanner) {\n    YYG_DECL;\n    yyin = in;\n}\n\n");
+        emit(e, "FILE *yyget_in(yyscan_t yyscanner) {\n    YYG_DECL;\n    return yyin;\n}\n\n");
+        emit(e, "void yyset_out(FILE *out, yyscan_t yyscanner) {\n    YYG_DECL;\n    yyout = out;\n}\n\n");
+        emit(e, "FILE *yyget_out(yyscan_t yyscanner) {\n    YYG_DECL;\n    return yyout;\n}\n\n");
+        emit(e, "YY_EXTRA_TYPE yyget_extra(yyscan_t yyscanner) {\n    YYG_DECL;\n    return yyextra;\n}\n\n");
+        emit(e, "void yyset_extra(YY_EXTRA_TYPE extra, yyscan_t yyscanner) {\n    YYG_DECL;\n    yyextra = extra;\n}\n\n");
+        emit(e, "char *yyget_text(yyscan_t yyscanner) {\n    YYG_DECL;\n    return yytext;\n}\n\n");
+        emit(e, "int yyget_leng(yyscan_t yyscanner) {\n    YYG_DECL;\n    return yyleng;\n}\n\n");
+    }
+}
+
+/* Which byte values go to which target; target -1 ends the match. */
+static void emit_state(Emitter *e, const Dfa *dfa, int s) {
+    int k = dfa->class_count;
+    int target[256];
+    int bytes_to[dfa->state_count + 1];
+
+    emit(e, "yy_s%d:\n", s);
+    if (dfa->accept[s] >= 0) emit(e, "    yy_accept = %d;\n    yy_marker = yy_cursor;\n", dfa->accept[s]);
+
+    bool any = false;
+    for (int c = 0; c < k; c++) any = any || dfa->next[s * k + c] >= 0;
+    if (!any) {
+        emit(e, "    goto yy_match;\n");
+        return;
+    }
+
+    for (int b = 0; b < 256; b++) target[b] = dfa->next[s * k + dfa->byte_class[b]];
+    for (int t = 0; t <= dfa->state_count; t++) bytes_to[t] = 0;
+    for (int b = 1; b < 256; b++) bytes_to[target[b] + 1]++;
+    int fallback = -1;
+    for (int t = -1; t < dfa->state_count; t++) {
+        if (bytes_to[t + 1] > bytes_to[fallback + 1]) fallback = t;
+    }
+
+    emit(e, "    yych = (unsigned char)*yy_cursor;\n    switch (yych) {\n");
+    emit(e, "    case 0x00:\n        if (yy_cursor == yy_limit) {\n");
+    emit(e, "            if (YY_REFILL()) goto yy_s%d;\n            goto yy_match;\n        }\n", s);
+    if (target[0] >= 0) {
+        emit(e, "        yy_cursor++;\n        goto yy_s%d;\n", target[0]);
+    } else {
+        emit(e, "        goto yy_match;\n");
+    }
+    for (int t = -1; t < dfa->state_count; t++) {
+        if (t == fallback || bytes_to[t + 1] == 0) continue;
+        int column = 0;
+        for (int b = 1; b < 256; b++) {
+            if (target[b] != t) continue;
+            emit(e, column == 0 ? "    case 0x%02x:" : " case 0x%02x:", b);
+            if (++column == 6) {
+                emit(e, "\n");
+                column = 0;
+            }
+        }
+        if (column) emit(e, "\n");
+        if (t >= 0) {
+            emit(e, "        yy_cursor++;\n        goto yy_s%d;\n", t);
+        } else {
+            emit(e, "        goto yy_match;\n");
+        }
+    }
+    if (fallback >= 0) {
+        emit(e, "    default:\n        yy_cursor++;\n        goto yy_s%d;\n    }\n", fallback);
+    } else {
+        emit(e, "    default:\n        goto yy_match;\n    }\n");
+    }
+}
+
+static void emit_yylex(Emitter *e, const Spec *spec, const Dfa *dfa) {
+    emit(e, "#define YY_REFILL() (yy_refill(yyg, &yy_start, &yy_cursor, &yy_marker) ? (yy_limit = yyg->current->limit, 1) : 0)\n\n");
+    emit(e, "int yylex(%s) {\n    YYG_DECL;\n", spec->reentrant ? "yyscan_t yyscanner" : "void");
+    emit(e, "    if (!yyin) yyin = stdin;\n    if (!yyout) yyout = stdout;\n");
+    emit(e, "    if (!yyg->current) yy_file_buffer(yyg, yyin);\n");
+    if (spec->rules_code.text) emit_code(e, spec, spec->rules_code.text, spec->rules_code.line);
+    emit(e, "\n    for (;;) {\n");
+    emit(e, "        char *yy_start, *yy_cursor, *yy_marker, *yy_limit;\n");
+    emit(e, "        int yy_accept = -1, yy_act;\n        unsigned char yych;\n\n");
+    emit(e, "        yy_cursor = yyg->cursor;\n        *yy_cursor = yyg->hold;\n");
+    emit(e, "        yy_limit = yyg->current->limit;\n        yy_start = yy_marker = yy_cursor;\n");
+    emit(e, "        if (yy_cursor == yy_limit && !YY_REFILL()) {\n");
+    emit(e, "            yyg->cursor = yy_cursor;\n            yyg->hold = *yy_cursor;\n");
+    emit(e, "            if (%s) return YY_NULL;\n", spec->reentrant ? "yywrap(yyscanner)" : "yywrap()");
+    emit(e, "            yyrestart(yyin%s);\n            continue;\n        }\n\n", spec->reentrant ? ", yyscanner" : "");
+
+    for (int s = 0; s < dfa->state_count; s++) emit_state(e, dfa, s);
+
+    emit(e, "\nyy_match:\n");
+    emit(e, "        if (yy_accept < 0) {\n            yy_cursor = yy_start + 1;\n            yy_act = %d;\n", spec->rule_count);
+    emit(e, "        } else {\n            yy_cursor = yy_marker;\n            yy_act = yy_accept;\n        }\n");
+    emit(e, "        yytext = yy_start;\n        yyleng = (int)(yy_cursor - yy_start);\n");
+    emit(e, "        yyg->hold = *yy_cursor;\n        *yy_cursor = '\\0';\n        yyg->cursor = yy_cursor;\n");
+    emit(e, "        YY_USER_ACTION\n\n        switch (yy_act) {\n");
+    for (int i = 0; i < spec->rule_count; i++) {
+        emit(e, "        case %d:\n", i);
+        if (i + 1 < spec->rule_count && spec->rules[i + 1].action == spec->rules[i].action) continue;
+        emit_code(e, spec, spec->rules[i].action, spec->rules[i].line);
+        emit(e, "        YY_BREAK\n");
+    }
+    emit(e, "        default:\n            ECHO;\n            YY_BREAK\n        }\n    }\n}\n\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *input = NULL, *output = NULL;
+    bool stats = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0) {
+            stats = true;
+        } else if (argv[i][0] != '-' && !input) {
+            input = argv[i];
+        } else {
+            input = NULL;
+            break;
+        }
+    }
+    if (!input) {
+        fprintf(stderr, "Usage: %s [-o OUT.c] [-s] SCANNER.l\n", argv[0]);
+        return 1;
+    }
+
+    static Spec spec;
+    Nfa nfa = { 0 };
+    Dfa dfa = { 0 }, min = { 0 };
+
+    parse_spec(&spec, input);
+    build_nfa(&spec, &nfa);
+    compute_classes(&nfa, &dfa);
+    build_dfa(&nfa, &dfa);
+    minimize_dfa(&dfa, &min);
+
+    if (stats) {
+        fprintf(stderr, "%s: %d rules, %d NFA states, %d byte classes, %d DFA states, %d after minimization\n",
+                input, spec.rule_count, nfa.count, dfa.class_count, dfa.state_count, min.state_count);
+    }
+
+    char default_out[4096];
+    if (!output) {
+        snprintf(default_out, sizeof(default_out), "%.*s.scan.c",
+                 (int)(strlen(input) > 2 && strcmp(input + strlen(input) - 2, ".l") == 0 ? strlen(input) - 2 : strlen(input)),
+                 input);
+        output = default_out;
+    }
+    Emitter e = { fopen(output, "w"), output, 1 };
+    if (!e.out) fatal("cannot write %s", output);
+
+    emit_runtime_head(&e, &spec);
+    for (int i = 0; i < spec.code_count; i++) emit_code(&e, &spec, spec.code[i].text, spec.code[i].line);
+    emit_runtime_defaults(&e);
+    emit_runtime_functions(&e, &spec);
+    emit_yylex(&e, &spec, &min);
+    if (spec.user_code.text && *spec.user_code.text) {
+        emit_code(&e, &spec, spec.user_code.text, spec.user_code.line);
+    }
+    if (fclose(e.out) != 0) fatal("cannot write %s", output);
+    return 0;
+}
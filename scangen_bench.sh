@@ -0,0 +1,86 @@
+#!/bin/sh
+# Compares the scanner scangen writes for practical08.l with the flex
+# scanner in lex.yy.c, which is generated from the same file.
+#
+#   ./scangen_bench.sh [SIZE_MB] [RUNS]
+#
+# Both are built with the same compiler and flags and run on a corpus of
+# the repo's C sources repeated to SIZE_MB, and on random bytes. Their
+# full token output must match byte for byte, read from a stream and
+# mapped with -m; then the token-counting mode (-q) is timed, best of
+# RUNS. The DFA sizes come from scangen -s.
+#
+# Needs cc, cmp and awk. Work files go to scangen_bench/.
+
+set -e
+
+SIZE_MB=${1:-32}
+RUNS=${2:-3}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+
+cd "$(dirname "$0")"
+WORK=scangen_bench
+mkdir -p "$WORK"
+
+"$CC" $CFLAGS -o "$WORK/scangen" scangen.c
+"$WORK/scangen" -s -o "$WORK/practical08_scangen.c" practical08.l
+"$CC" $CFLAGS -o "$WORK/practical08_scangen" "$WORK/practical08_scangen.c"
+"$CC" $CFLAGS -o "$WORK/practical08_flex" lex.yy.c
+
+bytes=$((SIZE_MB * 1024 * 1024))
+: > "$WORK/c_source.txt"
+while [ "$(wc -c < "$WORK/c_source.txt")" -lt "$bytes" ]; do
+    cat ./*.c >> "$WORK/c_source.txt"
+done
+head -c $((bytes / 8)) /dev/urandom > "$WORK/random.bin"
+
+status=0
+for corpus in c_source.txt random.bin; do
+    for mode in "" -m; do
+        "$WORK/practical08_flex" $mode "$WORK/$corpus" > "$WORK/flex.out"
+        "$WORK/practical08_scangen" $mode "$WORK/$corpus" > "$WORK/scangen.out"
+        if cmp -s "$WORK/flex.out" "$WORK/scangen.out"; then
+            echo "$corpus ${mode:-stream}: token streams match"
+        else
+            echo "$corpus ${mode:-stream}: token streams DIFFER" >&2
+            status=1
+        fi
+    done
+done
+rm -f "$WORK/flex.out" "$WORK/scangen.out"
+
+now_ns() {
+    date +%s%N
+}
+
+# Best wall time in ns of RUNS runs of "$@".
+best_ns() {
+    best=0
+    i=0
+    while [ "$i" -lt "$RUNS" ]; do
+        start=$(now_ns)
+        "$@" > /dev/null
+        end=$(now_ns)
+        t=$((end - start))
+        if [ "$best" -eq 0 ] || [ "$t" -lt "$best" ]; then best=$t; fi
+        i=$((i + 1))
+    done
+    echo "$best"
+}
+
+mb_per_s() {
+    awk -v bytes="$(wc -c < "$1")" -v ns="$2" 'BEGIN { printf "%.1f", bytes / 1048576 / (ns / 1e9) }'
+}
+
+printf '\n%-10s %-7s %12s %12s %9s\n' corpus input "flex MB/s" "scangen MB/s" speedup
+for corpus in c_source.txt random.bin; do
+    for mode in "" -m; do
+        f_ns=$(best_ns "$WORK/practical08_flex" -q $mode "$WORK/$corpus")
+        s_ns=$(best_ns "$WORK/practical08_scangen" -q $mode "$WORK/$corpus")
+        printf '%-10s %-7s %12s %12s %8sx\n' "${corpus%.*}" "${mode:-stream}" \
+            "$(mb_per_s "$WORK/$corpus" "$f_ns")" "$(mb_per_s "$WORK/$corpus" "$s_ns")" \
+            "$(awk -v f="$f_ns" -v s="$s_ns" 'BEGIN { printf "%.2f", f / s }')"
+    done
+done
+exit $status
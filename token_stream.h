@@ -0,0 +1,288 @@
+/*
+ * Binary columnar token stream shared by the lexers and the tools that
+ * read their output.
+ *
+ * A stream is one block of bytes, in the writer's byte order:
+ *
+ *   header                      struct token_stream_header (24 bytes)
+ *   uint32_t starts[count]      byte offset of each token in the input
+ *   uint32_t lengths[count]     length in bytes
+ *   uint32_t lines[count]       line the token starts on, from 1
+ *   uint8_t  kinds[count]       token kind, an index into the names
+ *   char     names[names_size]  kind_count NUL-terminated kind names
+ *
+ * The uint32 columns start on 4-byte boundaries, so a reader that maps the
+ * block uses them in place. A target of the form "shm:/NAME" is a POSIX
+ * shared-memory object; anything else is a file path.
+ */
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define TOKEN_STREAM_MAGIC "TKS1"
+#define TOKEN_STREAM_SHM_PREFIX "shm:"
+
+struct token_stream_header {
+    char magic[4];
+    uint32_t kind_count;
+    uint64_t count;
+    uint32_t names_size;
+    uint32_t reserved;
+};
+
+/* Columns collected by a lexer until the stream is saved. */
+struct token_stream_writer {
+    uint32_t *starts;
+    uint32_t *lengths;
+    uint32_t *lines;
+    uint8_t *kinds;
+    size_t count;
+    size_t capacity;
+};
+
+/* A stream in memory: mapped (zero-copy) or, on Windows, read in. */
+struct token_stream_view {
+    void *base;
+    size_t size;
+    int mapped;
+    uint64_t count;
+    const uint32_t *starts;
+    const uint32_t *lengths;
+    const uint32_t *lines;
+    const uint8_t *kinds;
+    uint32_t kind_count;
+    const char *names;
+    uint32_t names_size;
+};
+
+#define TOKEN_STREAM_NO_MEMORY (-1)
+#define TOKEN_STREAM_TOO_LARGE (-2)
+
+/*
+ * Appends one token. Returns 0, TOKEN_STREAM_NO_MEMORY, or
+ * TOKEN_STREAM_TOO_LARGE if the token ends past what the 32-bit columns
+ * can hold (inputs of 4 GiB or more); nothing is stored on failure.
+ */
+static inline int token_stream_push(struct token_stream_writer *w, int kind, size_t start, size_t length, int line) {
+    if (start > UINT32_MAX || length > UINT32_MAX - start || line < 0) return TOKEN_STREAM_TOO_LARGE;
+    if (w->count == w->capacity) {
+        size_t capacity = w->capacity ? w->capacity * 2 : 4096;
+        uint32_t *starts = realloc(w->starts, capacity * sizeof(uint32_t));
+        if (starts) w->starts = starts;
+        uint32_t *lengths = realloc(w->lengths, capacity * sizeof(uint32_t));
+        if (lengths) w->lengths = lengths;
+        uint32_t *lines = realloc(w->lines, capacity * sizeof(uint32_t));
+        if (lines) w->lines = lines;
+        uint8_t *kinds = realloc(w->kinds, capacity);
+        if (kinds) w->kinds = kinds;
+        if (!starts || !lengths || !lines || !kinds) return TOKEN_STREAM_NO_MEMORY;
+        w->capacity = capacity;
+    }
+    w->starts[w->count] = (uint32_t)start;
+    w->lengths[w->count] = (uint32_t)length;
+    w->lines[w->count] = (uint32_t)line;
+    w->kinds[w->count] = (uint8_t)kind;
+    w->count++;
+    return 0;
+}
+
+/* Message for a failed token_stream_push. */
+static inline const char *token_stream_error(int code) {
+    return code == TOKEN_STREAM_TOO_LARGE ? "Input too large for a token stream (offsets are 32-bit)"
+                                          : "Out of memory for the token stream";
+}
+
+static inline void token_stream_free(struct token_stream_writer *w) {
+    free(w->starts);
+    free(w->lengths);
+    free(w->lines);
+    free(w->kinds);
+    memset(w, 0, sizeof(*w));
+}
+
+static inline size_t token_stream_names_size(const char *const *names, int kind_count) {
+    size_t size = 0;
+    for (int k = 0; k < kind_count; k++) size += strlen(names[k]) + 1;
+    return size;
+}
+
+/* Lays the header, columns and names out at dst, which holds the whole stream. */
+static inline void token_stream_layout(unsigned char *dst, const struct token_stream_writer *w,
+                                       const char *const *names, int kind_count, size_t names_size) {
+    struct token_stream_header header;
+    memcpy(header.magic, TOKEN_STREAM_MAGIC, 4);
+    header.kind_count = (uint32_t)kind_count;
+    header.count = w->count;
+    header.names_size = (uint32_t)names_size;
+    header.reserved = 0;
+
+    size_t column = w->count * sizeof(uint32_t);
+    memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    if (w->count) {
+        memcpy(dst, w->starts, column);
+        memcpy(dst + column, w->lengths, column);
+        memcpy(dst + 2 * column, w->lines, column);
+        memcpy(dst + 3 * column, w->kinds, w->count);
+    }
+    dst += 3 * column + w->count;
+    for (int k = 0; k < kind_count; k++) {
+        size_t len = strlen(names[k]) + 1;
+        memcpy(dst, names[k], len);
+        dst += len;
+    }
+}
+
+/* Writes the stream to target. Returns 0, or -1 with a message on stderr. */
+static inline int token_stream_save(const struct token_stream_writer *w, const char *target,
+                                    const char *const *names, int kind_count) {
+    size_t names_size = token_stream_names_size(names, kind_count);
+    size_t size = sizeof(struct token_stream_header) + w->count * (3 * sizeof(uint32_t) + 1) + names_size;
+
+    if (w->count > UINT32_MAX) {
+        fprintf(stderr, "Error: Too many tokens for a token stream\n");
+        return -1;
+    }
+#ifndef _WIN32
+    if (strncmp(target, TOKEN_STREAM_SHM_PREFIX, strlen(TOKEN_STREAM_SHM_PREFIX)) == 0) {
+        const char *name = target + strlen(TOKEN_STREAM_SHM_PREFIX);
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, (off_t)size) != 0) {
+            fprintf(stderr, "Error: Cannot create shared memory %s\n", name);
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            fprintf(stderr, "Error: Cannot map shared memory %s\n", name);
+            return -1;
+        }
+        token_stream_layout(base, w, names, kind_count, names_size);
+        munmap(base, size);
+        return 0;
+    }
+#endif
+    unsigned char *block = malloc(size);
+    FILE *out = fopen(target, "wb");
+    int status = 0;
+    if (!block || !out) {
+        fprintf(stderr, "Error: Cannot write token stream %s\n", target);
+        status = -1;
+    } else {
+        token_stream_layout(block, w, names, kind_count, names_size);
+        if (fwrite(block, 1, size, out) != size) {
+            fprintf(stderr, "Error: Cannot write token stream %s\n", target);
+            status = -1;
+        }
+    }
+    if (out && fclose(out) != 0) status = -1;
+    free(block);
+    return status;
+}
+
+/* Checks the header and points the view's columns into its block. */
+static inline int token_stream_bind(struct token_stream_view *v) {
+    struct token_stream_header header;
+    if (v->size < sizeof(header)) return -1;
+    memcpy(&header, v->base, sizeof(header));
+    if (memcmp(header.magic, TOKEN_STREAM_MAGIC, 4) != 0) return -1;
+    if (header.count > (v->size - sizeof(header)) / (3 * sizeof(uint32_t) + 1)) return -1;
+
+    size_t column = (size_t)header.count * sizeof(uint32_t);
+    const unsigned char *p = (const unsigned char *)v->base + sizeof(header);
+    if (sizeof(header) + 3 * column + header.count + header.names_size != v->size) return -1;
+    v->count = header.count;
+    v->starts = (const uint32_t *)p;
+    v->lengths = (const uint32_t *)(p + column);
+    v->lines = (const uint32_t *)(p + 2 * column);
+    v->kinds = p + 3 * column;
+    v->kind_count = header.kind_count;
+    v->names = (const char *)(p + 3 * column + header.count);
+    v->names_size = header.names_size;
+    if (v->names_size == 0 ? v->kind_count != 0 : v->names[v->names_size - 1] != '\0') return -1;
+    return 0;
+}
+
+static inline void token_stream_close(struct token_stream_view *v) {
+#ifndef _WIN32
+    if (v->mapped && v->base) munmap(v->base, v->size);
+#endif
+    if (!v->mapped) free(v->base);
+    memset(v, 0, sizeof(*v));
+}
+
+/*
+ * Opens the stream at target read-only. It is mapped where mmap exists,
+ * so the columns are read in place. Returns 0, or -1 with a message on
+ * stderr.
+ */
+static inline int token_stream_open(const char *target, struct token_stream_view *v) {
+    memset(v, 0, sizeof(*v));
+#ifndef _WIN32
+    int fd;
+    if (strncmp(target, TOKEN_STREAM_SHM_PREFIX, strlen(TOKEN_STREAM_SHM_PREFIX)) == 0) {
+        fd = shm_open(target + strlen(TOKEN_STREAM_SHM_PREFIX), O_RDONLY, 0);
+    } else {
+        fd = open(target, O_RDONLY);
+    }
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open token stream %s\n", target);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    v->size = (size_t)st.st_size;
+    v->base = v->size ? mmap(NULL, v->size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (v->base == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map token stream %s\n", target);
+        v->base = NULL;
+        return -1;
+    }
+    v->mapped = 1;
+#else
+    FILE *in = fopen(target, "rb");
+    if (!in) {
+        fprintf(stderr, "Error: Cannot open token stream %s\n", target);
+        return -1;
+    }
+    fseek(in, 0, SEEK_END);
+    v->size = (size_t)ftell(in);
+    fseek(in, 0, SEEK_SET);
+    v->base = malloc(v->size ? v->size : 1);
+    if (!v->base || fread(v->base, 1, v->size, in) != v->size) {
+        fprintf(stderr, "Error: Cannot read token stream %s\n", target);
+        fclose(in);
+        free(v->base);
+        v->base = NULL;
+        return -1;
+    }
+    fclose(in);
+#endif
+    if (token_stream_bind(v) != 0) {
+        fprintf(stderr, "Error: %s is not a token stream\n", target);
+        token_stream_close(v);
+        return -1;
+    }
+    return 0;
+}
+
+/* Name of kind, or NULL if the stream does not name it. */
+static inline const char *token_stream_kind_name(const struct token_stream_view *v, unsigned kind) {
+    const char *name = v->names;
+    for (unsigned k = 0; k < kind && k < v->kind_count; k++) name += strlen(name) + 1;
+    return kind < v->kind_count ? name : NULL;
+}
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * Reads a binary token stream written by a lexer's -t option (see
+ * token_stream.h) and prints it, as an example of a downstream stage that
+ * takes tokens without re-lexing.
+ *
+ *   gcc -O2 -o token_stream_dump token_stream_dump.c
+ *   ./practical07_lexer -t shm:/p07 input.c && ./token_stream_dump -s input.c shm:/p07
+ *   ./token_stream_dump [-c] [-s SOURCE] [-u] FILE|shm:/NAME
+ *
+ * The stream is mapped and its columns are read in place. With -s the
+ * source file is mapped too and each token's text is printed from it.
+ * -c prints only the number of tokens of each kind. -u removes a
+ * shared-memory stream after reading it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "token_stream.h"
+
+/* The source the offsets point into; mapped where mmap exists. */
+typedef struct {
+    char *text;
+    size_t size;
+    bool mapped;
+} Source;
+
+static bool load_source(const char *path, Source *src) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        fprintf(stderr, "Error: Cannot open file %s\n", path);
+        return false;
+    }
+    fseek(in, 0, SEEK_END);
+    src->size = (size_t)ftell(in);
+    fseek(in, 0, SEEK_SET);
+    src->mapped = false;
+#ifndef _WIN32
+    if (src->size > 0) {
+        void *base = mmap(NULL, src->size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+        if (base != MAP_FAILED) {
+            src->text = base;
+            src->mapped = true;
+            fclose(in);
+            return true;
+        }
+    }
+#endif
+    src->text = malloc(src->size ? src->size : 1);
+    bool ok = src->text && fread(src->text, 1, src->size, in) == src->size;
+    fclose(in);
+    if (!ok) fprintf(stderr, "Error: Cannot read file %s\n", path);
+    return ok;
+}
+
+static void free_source(Source *src) {
+#ifndef _WIN32
+    if (src->mapped) {
+        munmap(src->text, src->size);
+        return;
+    }
+#endif
+    free(src->text);
+}
+
+static void print_tokens(const struct token_stream_view *v, const Source *src) {
+    for (uint64_t i = 0; i < v->count; i++) {
+        const char *name = token_stream_kind_name(v, v->kinds[i]);
+        printf("%6u %10u %6u  %-15s", v->lines[i], v->starts[i], v->lengths[i], name ? name : "?");
+        if (src && (size_t)v->starts[i] + v->lengths[i] <= src->size) {
+            printf(" %.*s", (int)v->lengths[i], src->text + v->starts[i]);
+        }
+        putchar('\n');
+    }
+}
+
+static void print_counts(const struct token_stream_view *v) {
+    uint64_t counts[256] = { 0 };
+    for (uint64_t i = 0; i < v->count; i++) counts[v->kinds[i]]++;
+    for (unsigned k = 0; k < 256; k++) {
+        if (counts[k] == 0) continue;
+        const char *name = token_stream_kind_name(v, k);
+        printf("%-15s %llu\n", name ? name : "?", (unsigned long long)counts[k]);
+    }
+    printf("%-15s %llu\n", "total", (unsigned long long)v->count);
+}
+
+int main(int argc, char *argv[]) {
+    const char *source_path = NULL, *target = NULL;
+    bool counts_only = false, unlink_after = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            source_path = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0) {
+            counts_only = true;
+        } else if (strcmp(argv[i], "-u") == 0) {
+            unlink_after = true;
+        } else if (argv[i][0] != '-' && !target) {
+            target = argv[i];
+        } else {
+            target = NULL;
+            break;
+        }
+    }
+    if (!target) {
+        fprintf(stderr, "Usage: %s [-c] [-s SOURCE] [-u] FILE|shm:/NAME\n", argv[0]);
+        return 1;
+    }
+
+    struct token_stream_view view;
+    if (token_stream_open(target, &view) != 0) return 1;
+
+    Source src;
+    bool have_source = source_path && !counts_only;
+    if (have_source && !load_source(source_path, &src)) {
+        token_stream_close(&view);
+        return 1;
+    }
+
+    if (counts_only) {
+        print_counts(&view);
+    } else {
+        printf("%6s %10s %6s  %-15s%s\n", "line", "start", "length", "kind", have_source ? " text" : "");
+        print_tokens(&view, have_source ? &src : NULL);
+    }
+
+    if (have_source) free_source(&src);
+    token_stream_close(&view);
+#ifndef _WIN32
+    if (unlink_after && strncmp(target, TOKEN_STREAM_SHM_PREFIX, strlen(TOKEN_STREAM_SHM_PREFIX)) == 0) {
+        shm_unlink(target + strlen(TOKEN_STREAM_SHM_PREFIX));
+    }
+#else
+    (void)unlink_after;
+#endif
+    return 0;
+}